@@ -0,0 +1,165 @@
+// Copyright (C) 2011 Paul Ilardi (http://github.com/CodePi)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, unconditionally.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+// Holds the current snapshot of a config for concurrent readers.  Reading
+// is wait-free: it never locks or retries, so readers don't slow each other
+// down.  Writers make a modified copy and publish it, and the previous
+// snapshot is released once no reader is using it.
+//
+// Readers announce themselves in counters spread over cache lines, one per
+// thread where possible.  There are two sets of counters, and the version
+// number selects the set new readers use.  A writer publishes the new
+// snapshot, waits for readers in the other set, switches sets and waits for
+// readers in the previous set.  Then nobody can still be using the old
+// snapshot.
+
+/* Example usage:
+  ConfigSnapshot<MyConfig> config;
+  config.readString("port=8080");                 // writer thread
+  ConfigSnapshot<MyConfig>::Reader cfg = config.read(); // reader threads
+  use(cfg->port);
+*/
+
+#pragma once
+
+#include "configurator.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+
+namespace codepi {
+
+template <typename T>
+class ConfigSnapshot{
+  struct Slot;
+public:
+  /// starts with a default constructed T
+  ConfigSnapshot() : mVersion(0) {
+    mCurrent = new std::shared_ptr<const T>(std::make_shared<T>());
+  }
+  explicit ConfigSnapshot(std::shared_ptr<const T> initial) : mVersion(0) {
+    mCurrent = new std::shared_ptr<const T>(initial);
+  }
+  /// there must be no Readers left
+  ~ConfigSnapshot(){ delete mCurrent.load(); }
+
+  /// Access to a snapshot.  The snapshot stays valid while the Reader
+  ///   exists, so keep it short lived: writers wait for it to be destroyed.
+  class Reader{
+  public:
+    Reader(Reader&& rhs) : mpVal(rhs.mpVal), mpCount(rhs.mpCount) { rhs.mpCount = NULL; }
+    ~Reader(){ if(mpCount) mpCount->fetch_sub(1, std::memory_order_release); }
+
+    const T& operator*() const { return **mpVal; }
+    const T* operator->() const { return mpVal->get(); }
+    const T& get() const { return **mpVal; }
+    /// reference counted pointer to the snapshot, for keeping it longer
+    std::shared_ptr<const T> share() const { return *mpVal; }
+
+  private:
+    friend class ConfigSnapshot;
+    Reader(const std::shared_ptr<const T>* val, std::atomic<long>* count) : mpVal(val), mpCount(count) {}
+    Reader(const Reader&);
+    Reader& operator=(const Reader&);
+
+    const std::shared_ptr<const T>* mpVal;
+    std::atomic<long>* mpCount;
+  };
+
+  /// current snapshot.  Wait-free, can be called from any thread.  Don't
+  ///   publish from a thread while it holds a Reader, that would wait forever.
+  Reader read() const {
+    std::atomic<long>* count = &mSlots[threadSlot()].count[mVersion.load() & 1];
+    count->fetch_add(1);
+    return Reader(mCurrent.load(), count);
+  }
+
+  /// current snapshot, as a reference counted pointer
+  std::shared_ptr<const T> get() const { return read().share(); }
+
+  /// number of snapshots published since construction
+  unsigned long long version() const { return mVersion.load(); }
+
+  /// replace the snapshot.  Writers are serialized, and wait until readers
+  ///   of the previous snapshot are done
+  void publish(std::shared_ptr<const T> next){
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    const std::shared_ptr<const T>* old = mCurrent.exchange(new std::shared_ptr<const T>(next));
+    unsigned long long version = mVersion.load();
+    waitForReaders((version+1) & 1); // readers from before the last switch
+    mVersion.store(version+1);
+    waitForReaders(version & 1);
+    delete old;
+  }
+
+  /// copy the current snapshot, apply modify to the copy and publish it.
+  ///   If modify throws, nothing is published.
+  void update(const std::function<void(T&)>& modify){
+    std::lock_guard<std::mutex> lock(mUpdateMutex);
+    std::shared_ptr<T> copy = std::make_shared<T>();
+    *copy = read().get();
+    modify(*copy);
+    publish(copy);
+  }
+
+  /// update with Configurator::set / readString
+  void set(const std::string& varName, const std::string& val){
+    update([&](T& cfg){ cfg.set(varName, val); });
+  }
+  void readString(const std::string& str){
+    update([&](T& cfg){ cfg.readString(str); });
+  }
+
+  /// number of reader counter slots.  Threads beyond this share slots
+  static const size_t SLOTS = 64;
+
+private:
+  ConfigSnapshot(const ConfigSnapshot&);
+  ConfigSnapshot& operator=(const ConfigSnapshot&);
+
+  /// readers of each set, one cache line per slot
+  struct alignas(64) Slot{
+    Slot() { count[0] = 0; count[1] = 0; }
+    std::atomic<long> count[2];
+  };
+
+  /// slot of the calling thread, threads are assigned slots round robin
+  static size_t threadSlot(){
+    static std::atomic<size_t> next(0);
+    static thread_local size_t slot = next++ % SLOTS;
+    return slot;
+  }
+
+  void waitForReaders(int set){
+    // orders the exchange of mCurrent before the loads of the counts.  A
+    //   reader increments its count, then loads mCurrent: without the fence
+    //   both could see the other's old value, and the reader would get a
+    //   snapshot that is deleted after the count is seen as 0
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for(size_t i=0; i<SLOTS; i++){
+      while(mSlots[i].count[set].load(std::memory_order_acquire)!=0) std::this_thread::yield();
+    }
+  }
+
+  std::atomic<const std::shared_ptr<const T>*> mCurrent;
+  std::atomic<unsigned long long> mVersion;
+  mutable Slot mSlots[SLOTS];
+  std::mutex mWriteMutex, mUpdateMutex;
+};
+
+} //end namespace codepi
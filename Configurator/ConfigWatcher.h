@@ -0,0 +1,276 @@
+// Copyright (C) 2011 Paul Ilardi (http://github.com/CodePi)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, unconditionally.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+// Hot reload of a config file.  Reads a Configurator descendant from a file,
+// and reads it again on a background thread whenever that file or any file
+// it includes changes.  Each successful read is published as a new snapshot,
+// so readers never see a partially read config, and a failed read keeps the
+// previous snapshot.
+// Changes are detected with inotify on Linux, elsewhere by polling the
+// contents of the files.
+
+/* Example usage:
+  ConfigWatcher<MyConfig> watcher("app.cfg", [](const std::string& error){
+    std::cerr << error << std::endl;
+  });
+  std::shared_ptr<const MyConfig> cfg = watcher.get(); // latest snapshot
+  use(cfg->port);
+  use(watcher.read()->port); // cheaper, for short uses
+
+*/
+
+#pragma once
+
+#include "configurator.h"
+#include "ConfigSnapshot.h"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+namespace codepi {
+
+template <typename T>
+class ConfigWatcher{
+public:
+  typedef std::function<void(const std::string& error)> ErrorCallback;
+
+  /// reads filename, throws if that fails, then watches it on a background
+  ///   thread.  onError is called from that thread when a read fails.
+  ConfigWatcher(const std::string& filename, ErrorCallback onError=ErrorCallback())
+    : mFilename(filename), mOnError(onError), mVersion(0), mStop(false) {
+    std::shared_ptr<T> cfg = std::make_shared<T>();
+    cfg->readFile(filename, mFiles);
+#ifdef __linux__
+    mInotify = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+    if(pipe(mStopPipe)!=0) {
+      if(mInotify>=0) close(mInotify);
+      throw std::runtime_error("ConfigWatcher error, can't create pipe");
+    }
+#endif
+    watch();
+    publish(cfg);
+    mThread = std::thread(&ConfigWatcher::run, this);
+  }
+
+  ~ConfigWatcher(){
+    mStop = true;
+#ifdef __linux__
+    char c = 0;
+    if(write(mStopPipe[1], &c, 1)<0) {} // wake up poll()
+#endif
+    { std::lock_guard<std::mutex> lock(mStopMutex); }
+    mStopCond.notify_all();
+    mThread.join();
+#ifdef __linux__
+    if(mInotify>=0) close(mInotify);
+    close(mStopPipe[0]);
+    close(mStopPipe[1]);
+#endif
+  }
+
+  /// latest snapshot, never NULL.  Can be called from any thread, doesn't
+  ///   lock.  The snapshot stays valid as long as it is referenced.
+  std::shared_ptr<const T> get() const { return mSnapshot.get(); }
+
+  /// latest snapshot, without reference counting.  Wait-free, see
+  ///   ConfigSnapshot::read
+  typename ConfigSnapshot<T>::Reader read() const { return mSnapshot.read(); }
+
+  /// number of successful reads, starting at 1 for the read in the constructor
+  unsigned long long version() const { return mVersion; }
+
+  /// read the file now, on the calling thread.  Returns false (and calls
+  ///   onError) if reading fails
+  bool reload(){
+    std::unique_lock<std::mutex> lock(mMutex);
+    std::shared_ptr<T> cfg = std::make_shared<T>();
+    std::vector<std::string> files;
+    try{
+      cfg->readFile(mFilename, files);
+    }catch(std::exception& e){
+      // keep watching the files read so far too, e.g. a new include with an error
+      for(size_t i=0; i<files.size(); i++)
+        if(std::find(mFiles.begin(), mFiles.end(), files[i])==mFiles.end()) mFiles.push_back(files[i]);
+      watch();
+      lock.unlock();
+      if(mOnError) mOnError(e.what());
+      return false;
+    }
+    // watch before publishing, so no change after the publish is missed
+    mFiles.swap(files);
+    watch();
+    publish(cfg);
+    return true;
+  }
+
+  /// names of the files watched: those read by the last successful read,
+  ///   and by failed reads since
+  std::vector<std::string> files(){
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mFiles;
+  }
+
+  /// delay after a change before reading, so a file being written is read
+  ///   once it is complete
+  static const int SETTLE_MS = 50;
+  /// interval for polling the files, where inotify isn't available
+  static const int POLL_MS = 500;
+
+private:
+  ConfigWatcher(const ConfigWatcher&);
+  ConfigWatcher& operator=(const ConfigWatcher&);
+
+  void publish(const std::shared_ptr<T>& cfg){
+    mSnapshot.publish(cfg);
+    mVersion++;
+  }
+
+  /// start watching mFiles, called with mMutex held
+  void watch(){
+#ifdef __linux__
+    if(mInotify>=0){
+      // watch the directories, since editors often replace a file instead of writing to it
+      for(size_t i=0; i<mFiles.size(); i++){
+        std::string dir, name;
+        splitPath(mFiles[i], dir, name);
+        int wd = inotify_add_watch(mInotify, dir.c_str(),
+          IN_CLOSE_WRITE|IN_MOVED_TO|IN_CREATE|IN_DELETE|IN_ATTRIB);
+        if(wd>=0) mWatchDirs[wd] = dir;
+      }
+      return;
+    }
+#endif
+    mHashes = contentHashes(mFiles);
+  }
+
+  /// watch thread
+  void run(){
+#ifdef __linux__
+    if(mInotify>=0) { runInotify(); return; }
+#endif
+    runPolling();
+  }
+
+  /// waits up to ms for stop, returns true if stopping
+  bool waitForStop(int ms){
+    std::unique_lock<std::mutex> lock(mStopMutex);
+    return mStopCond.wait_for(lock, std::chrono::milliseconds(ms), [this]{ return (bool)mStop; });
+  }
+
+  /// hash of the contents of each file, 0 if missing.  Config files are
+  ///   small, and modification times may only have a resolution of seconds
+  static std::vector<size_t> contentHashes(const std::vector<std::string>& files){
+    std::vector<size_t> hashes;
+    for(size_t i=0; i<files.size(); i++){
+      std::ifstream ifs(files[i].c_str(), std::ios::binary);
+      std::string contents((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+      hashes.push_back(ifs ? std::hash<std::string>()(contents) : 0);
+    }
+    return hashes;
+  }
+
+  /// true if the contents of the files differ from those last watched
+  bool filesChanged(){
+    std::vector<std::string> files;
+    std::vector<size_t> hashes;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      files = mFiles;
+      hashes = mHashes;
+    }
+    return contentHashes(files)!=hashes;
+  }
+
+  void runPolling(){
+    while(!waitForStop(POLL_MS)){
+      if(!filesChanged()) continue;
+      if(waitForStop(SETTLE_MS)) break;
+      reload();
+    }
+  }
+
+#ifdef __linux__
+  /// splits path into directory and file name
+  static void splitPath(const std::string& path, std::string& dir, std::string& name){
+    size_t slash = path.find_last_of('/');
+    dir = slash==std::string::npos ? "." : slash==0 ? "/" : path.substr(0, slash);
+    name = slash==std::string::npos ? path : path.substr(slash+1);
+  }
+
+  /// reads pending events, returns true if one of them is for a watched file
+  bool readEvents(){
+    std::lock_guard<std::mutex> lock(mMutex);
+    bool changed = false;
+    alignas(struct inotify_event) char buf[4096];
+    ssize_t n;
+    while((n = ::read(mInotify, buf, sizeof(buf)))>0){
+      for(char* p=buf; p<buf+n; ){
+        struct inotify_event* ev = (struct inotify_event*)p;
+        p += sizeof(struct inotify_event)+ev->len;
+        if(ev->mask & IN_Q_OVERFLOW) { changed = true; continue; }
+        if(!ev->len || !mWatchDirs.count(ev->wd)) continue;
+        for(size_t i=0; i<mFiles.size(); i++){
+          std::string dir, name;
+          splitPath(mFiles[i], dir, name);
+          if(dir==mWatchDirs[ev->wd] && name==ev->name) changed = true;
+        }
+      }
+    }
+    return changed;
+  }
+
+  void runInotify(){
+    struct pollfd fds[2] = { { mInotify, POLLIN, 0 }, { mStopPipe[0], POLLIN, 0 } };
+    while(!mStop){
+      if(poll(fds, 2, -1)<=0 || fds[1].revents) continue;
+      if(!readEvents()) continue;
+      // wait until events stop arriving, i.e. the file is completely written
+      while(!mStop && poll(fds, 2, SETTLE_MS)>0 && !fds[1].revents) readEvents();
+      if(mStop) break;
+      reload();
+    }
+  }
+
+  int mInotify;
+  int mStopPipe[2];
+  std::map<int,std::string> mWatchDirs;
+#endif
+
+  std::string mFilename;
+  ErrorCallback mOnError;
+  ConfigSnapshot<T> mSnapshot;
+  std::atomic<unsigned long long> mVersion;
+  std::mutex mMutex;  // for reload, guards mFiles, mHashes, mWatchDirs
+  std::vector<std::string> mFiles;
+  std::vector<size_t> mHashes;
+  std::atomic<bool> mStop;
+  std::mutex mStopMutex;
+  std::condition_variable mStopCond;
+  std::thread mThread;
+};
+
+} //end namespace codepi
@@ -0,0 +1,175 @@
+// Copyright (C) 2011 Paul Ilardi (http://github.com/CodePi)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, unconditionally.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+// Wraps a struct or container entry that is parsed on first access.  When a
+// config is read, the text of the entry's value is only bracket matched and
+// kept.  Accessing the value in any way (get, conversion, ->, writing,
+// comparing) parses it first.  Used in place of the type it wraps, like
+// Optional.  First access is thread safe, so a shared config can be read
+// from several threads.
+//
+// Parse errors in the entry are thrown on first access instead of when the
+// config is read, and again on every later access until it is assigned.
+// Includes inside the entry are read on first access too.
+
+/* Example usage:
+  Lazy<BigSection> big;       // entry of a struct
+  cfg.readFile("cfg.txt");    // big is only bracket matched
+  cout << big->x;             // parses big, then accesses it
+*/
+
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace codepi {
+
+template <typename T>
+class Lazy{
+public:
+  /// parses text into val, e.g. Configurator::cfgParseLazy<T>
+  typedef void (*ParseFunc)(T& val, const std::string& text);
+
+  Lazy() : mPending(false), mParse(nullptr) {}
+
+  Lazy(const T& val) : mVal(val), mPending(false), mParse(nullptr) {}
+
+  // copies rhs, its pending text is parsed when either is accessed
+  Lazy(const Lazy<T>& rhs) : mPending(false), mParse(nullptr) {
+    *this = rhs;
+  }
+
+  Lazy(Lazy<T>&& rhs) : mPending(false), mParse(nullptr) {
+    *this = std::move(rhs);
+  }
+
+  Lazy<T>& operator=(const Lazy<T>& rhs){
+    if(this == &rhs) return *this;
+    std::lock(mMutex, rhs.mMutex);
+    std::lock_guard<std::mutex> lock(mMutex, std::adopt_lock);
+    std::lock_guard<std::mutex> rhsLock(rhs.mMutex, std::adopt_lock);
+    mVal = rhs.mVal;
+    mTexts = rhs.mTexts;
+    mError = rhs.mError;
+    mParse = rhs.mParse;
+    mPending = rhs.mPending.load();
+    return *this;
+  }
+
+  Lazy<T>& operator=(Lazy<T>&& rhs){
+    if(this == &rhs) return *this;
+    std::lock(mMutex, rhs.mMutex);
+    std::lock_guard<std::mutex> lock(mMutex, std::adopt_lock);
+    std::lock_guard<std::mutex> rhsLock(rhs.mMutex, std::adopt_lock);
+    mVal = std::move(rhs.mVal);
+    mTexts = std::move(rhs.mTexts);
+    mError = rhs.mError;
+    mParse = rhs.mParse;
+    mPending = rhs.mPending.load();
+    rhs.mTexts.clear();
+    rhs.mError = nullptr;
+    rhs.mPending = false;
+    return *this;
+  }
+
+  // assigns value, dropping any pending text
+  Lazy<T>& operator=(const T& rhs){
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTexts.clear();
+    mError = nullptr;
+    mPending = false;
+    mVal = rhs;
+    return *this;
+  }
+
+  Lazy<T>& operator=(T&& rhs){
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTexts.clear();
+    mError = nullptr;
+    mPending = false;
+    mVal = std::move(rhs);
+    return *this;
+  }
+
+  // returns true if there is text that hasn't been parsed yet
+  bool isPending() const { return mPending; }
+
+  // adds text to parse on first access with parse.  Texts are parsed in the
+  //   order they were added, as the entries would have been read
+  void addText(std::string text, ParseFunc parse){
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTexts.push_back(std::move(text));
+    mParse = parse;
+    mPending = true;
+  }
+
+  // returns reference, parsing pending text first
+  T& get(){
+    parsePending();
+    return mVal;
+  }
+
+  const T& get() const {
+    parsePending();
+    return mVal;
+  }
+
+  operator T&(){
+    return get();
+  }
+
+  operator const T&() const {
+    return get();
+  }
+
+  // allows access to instance methods and variables if payload is struct/class
+  T* operator->() { return &get(); }
+  const T* operator->() const { return &get(); }
+
+private:
+  // parses pending texts once, other threads accessing meanwhile wait.
+  //   If a text doesn't parse, the value stays pending and the error is
+  //   thrown on this and every later access
+  void parsePending() const {
+    if(!mPending) return;
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(!mPending) return;
+    if(mError) std::rethrow_exception(mError);
+    try{
+      for(size_t i=0; i<mTexts.size(); i++) mParse(mVal, mTexts[i]);
+    }catch(...){
+      mError = std::current_exception();
+      throw;
+    }
+    mTexts.clear();
+    mPending = false;
+  }
+
+  mutable T mVal;                          // payload
+  mutable std::vector<std::string> mTexts; // text not parsed yet
+  mutable std::exception_ptr mError;       // error parsing mTexts, if any
+  mutable std::atomic<bool> mPending;      // true if mTexts isn't empty
+  mutable std::mutex mMutex;               // held while parsing
+  ParseFunc mParse;
+};
+
+} // end namespace codepi
@@ -16,12 +16,13 @@
 // DEALINGS IN THE SOFTWARE.
 
 // Can wrap any type.  Can be used seamlessly in place of the type it wraps.  
-// Can be empty.  Automatically allocates space when needed
+// Can be empty.  The value is stored inline, so setting it doesn't allocate.
+// Since it is stored inline, T must be complete where Optional<T> is a member.
 
 /* Example usage:
   optional<int> i;            // i starts empty
   cout << i.isSet() << endl;  // returns false
-  i=1;                        // allocates i and sets to 1
+  i=1;                        // constructs i in place and sets to 1
   cout << i.isSet() << " " << i << endl; // returns true and 1
   foo(i);                     // passes i as int or int&
 */
@@ -30,6 +31,9 @@
 
 #include <iostream>
 #include <stdexcept>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace codepi {
 
@@ -37,7 +41,20 @@ template <typename T>
 class Optional{
 public:
   // object starts empty
-  Optional() = default;
+  Optional() {}
+
+  // makes a copy of rhs.
+  Optional(const Optional<T>& rhs){
+    if(rhs.isSet()) construct(*rhs.ptr());
+  }
+
+  // moves contents of rhs, leaving rhs empty.
+  Optional(Optional<T>&& rhs){
+    if(rhs.isSet()) {
+      construct(std::move(*rhs.ptr()));
+      rhs.unset();
+    }
+  }
 
   // makes a copy of rhs.
   template <typename U>
@@ -45,31 +62,31 @@ public:
     *this = std::forward<U>(rhs); // call assignment operator
   }
 
-  // deallocates if necessary
+  // destroys value if necessary
   ~Optional() { unset(); }
 
-  // returns true if allocated
-  bool isSet() const { return mpVal!=nullptr; }
+  // returns true if set
+  bool isSet() const { return mSet; }
 
   // sets to empty
   void unset(){
-    delete mpVal;
-    mpVal = nullptr;
+    if(mSet) ptr()->~T();
+    mSet = false;
   }
 
-  // returns reference.  Allocates if necessary.
+  // returns reference.  Default constructs if necessary.
   T& get(){
-    if(!mpVal) mpVal = new T;
-    return *mpVal;
+    if(!mSet) construct();
+    return *ptr();
   }
 
   // returns const reference.  Throws if empty.
   const T& get() const {
-    if(mpVal == nullptr) throw std::runtime_error("taking ref of empty const Optional");
-    return *mpVal;
+    if(!mSet) throw std::runtime_error("taking ref of empty const Optional");
+    return *ptr();
   }
 
-  // returns reference.  Allocates if necessary.
+  // returns reference.  Default constructs if necessary.
   operator T&(){
     return get();
   }
@@ -79,32 +96,36 @@ public:
     return get();
   }
 
-  // assigns value.  Allocates if necessary
+  // assigns value.  Constructs in place if empty
   Optional<T>& operator=(const T& rhs){
-    if(mpVal!=&rhs) get() = rhs;
+    if(!mSet) construct(rhs);
+    else if(ptr()!=&rhs) *ptr() = rhs;
     return *this;
   }
 
-  // copies value.  Allocates if necessary
+  // copies value.  Constructs in place if empty
   Optional<T>& operator=(const Optional<T>& rhs){
     if(this == &rhs) ;             // if self assignment, do nothing
     else if(!rhs.isSet()) unset(); // if rhs empty, empty lhs
-    else *this = *rhs.mpVal;       // else copy contents (call T assignment operator)
+    else *this = *rhs.ptr();       // else copy contents (call T assignment operator)
     return *this;
   }
 
-  // assigns value.  Allocates if necessary
+  // assigns value.  Constructs in place if empty
   Optional<T>& operator=(T&& rhs){
-    if(mpVal!=&rhs) get() = std::move(rhs);
+    if(!mSet) construct(std::move(rhs));
+    else if(ptr()!=&rhs) *ptr() = std::move(rhs);
     return *this;
   }
 
-  // moves value.
+  // moves value, leaving rhs empty.
   Optional<T>& operator=(Optional<T>&& rhs){
     if(this != &rhs) {       // if self assignment, do nothing
-      unset();               // unset current value
-      mpVal = rhs.mpVal;     // move from rhs to lhs
-      rhs.mpVal = nullptr;      // clear rhs
+      if(!rhs.isSet()) unset();
+      else {
+        *this = std::move(*rhs.ptr()); // move contents from rhs to lhs
+        rhs.unset();                   // clear rhs
+      }
     }
     return *this;
   }
@@ -114,7 +135,18 @@ public:
   const T* operator->() const { return &get(); }
 
 private:
-  T* mpVal = nullptr;   // payload
+  // constructs payload in mStorage from args, must be empty
+  template <typename... Args>
+  void construct(Args&&... args){
+    new (&mStorage) T(std::forward<Args>(args)...);
+    mSet = true;
+  }
+
+  T* ptr() { return reinterpret_cast<T*>(&mStorage); }
+  const T* ptr() const { return reinterpret_cast<const T*>(&mStorage); }
+
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type mStorage; // payload
+  bool mSet = false;   // true if mStorage holds a T
  };
 
 } // end namespace codepi
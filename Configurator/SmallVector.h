@@ -0,0 +1,193 @@
+// Copyright (C) 2011 Paul Ilardi (http://github.com/CodePi)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, unconditionally.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+// A vector that holds up to N elements inline, and only allocates when it
+// grows past N.  Has the parts of the std::vector interface that configs
+// use: iterators, indexing, push_back, insert, resize, reserve and clear.
+// Iterators are plain pointers, invalidated like std::vector's.
+
+/* Example usage:
+  SmallVector<int,4> v;       // room for 4 ints without allocating
+  v.push_back(1);             // stored inline
+  for(int i : v) cout << i;   // iterates like a vector
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace codepi {
+
+template <typename T, size_t N>
+class SmallVector{
+public:
+  typedef T value_type;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef T* iterator;
+  typedef const T* const_iterator;
+  typedef size_t size_type;
+
+  // object starts empty, using the inline storage
+  SmallVector() {}
+
+  SmallVector(std::initializer_list<T> list){
+    reserve(list.size());
+    for(const T& val : list) push_back(val);
+  }
+
+  SmallVector(const SmallVector& rhs){
+    *this = rhs;
+  }
+
+  // takes rhs's heap storage if it has any, otherwise moves its elements
+  SmallVector(SmallVector&& rhs){
+    *this = std::move(rhs);
+  }
+
+  ~SmallVector(){
+    clear();
+    if(!isInline()) ::operator delete(mpData);
+  }
+
+  SmallVector& operator=(const SmallVector& rhs){
+    if(this == &rhs) return *this;
+    clear();
+    reserve(rhs.size());
+    for(const T& val : rhs) push_back(val);
+    return *this;
+  }
+
+  SmallVector& operator=(SmallVector&& rhs){
+    if(this == &rhs) return *this;
+    clear();
+    if(!rhs.isInline()){ // take over rhs's storage
+      if(!isInline()) ::operator delete(mpData);
+      mpData = rhs.mpData;
+      mSize = rhs.mSize;
+      mCapacity = rhs.mCapacity;
+      rhs.mpData = rhs.inlineData();
+      rhs.mSize = 0;
+      rhs.mCapacity = N;
+    }else{
+      reserve(rhs.size());
+      for(T& val : rhs) push_back(std::move(val));
+      rhs.clear();
+    }
+    return *this;
+  }
+
+  size_t size() const { return mSize; }
+  bool empty() const { return mSize==0; }
+  size_t capacity() const { return mCapacity; }
+
+  T* data() { return mpData; }
+  const T* data() const { return mpData; }
+  iterator begin() { return mpData; }
+  iterator end() { return mpData+mSize; }
+  const_iterator begin() const { return mpData; }
+  const_iterator end() const { return mpData+mSize; }
+
+  T& operator[](size_t i) { return mpData[i]; }
+  const T& operator[](size_t i) const { return mpData[i]; }
+  T& back() { return mpData[mSize-1]; }
+  const T& back() const { return mpData[mSize-1]; }
+
+  // destroys all elements, keeping the storage
+  void clear(){
+    for(size_t i=0; i<mSize; i++) mpData[i].~T();
+    mSize = 0;
+  }
+
+  // moves the elements to heap storage for n elements, if n exceeds capacity
+  void reserve(size_t n){
+    if(n<=mCapacity) return;
+    T* data = static_cast<T*>(::operator new(n*sizeof(T)));
+    for(size_t i=0; i<mSize; i++){
+      new (data+i) T(std::move(mpData[i]));
+      mpData[i].~T();
+    }
+    if(!isInline()) ::operator delete(mpData);
+    mpData = data;
+    mCapacity = n;
+  }
+
+  // default constructs or destroys elements at the end to make size n
+  void resize(size_t n){
+    reserve(n);
+    while(mSize<n) new (mpData+mSize++) T();
+    while(mSize>n) mpData[--mSize].~T();
+  }
+
+  void push_back(const T& val){
+    emplace_back(val);
+  }
+
+  void push_back(T&& val){
+    emplace_back(std::move(val));
+  }
+
+  template <typename... Args>
+  void emplace_back(Args&&... args){
+    if(mSize==mCapacity) {
+      // construct first, args may refer to an element that grow() moves
+      T val(std::forward<Args>(args)...);
+      grow();
+      new (mpData+mSize) T(std::move(val));
+    }
+    else new (mpData+mSize) T(std::forward<Args>(args)...);
+    mSize++;
+  }
+
+  // inserts val before pos, returns iterator to the inserted element
+  iterator insert(const_iterator pos, T val){
+    size_t i = pos-mpData;
+    push_back(std::move(val));
+    std::rotate(mpData+i, mpData+mSize-1, mpData+mSize);
+    return mpData+i;
+  }
+
+  bool operator==(const SmallVector& rhs) const {
+    return mSize==rhs.mSize && std::equal(begin(), end(), rhs.begin());
+  }
+
+  bool operator!=(const SmallVector& rhs) const {
+    return !(*this==rhs);
+  }
+
+private:
+  T* inlineData() { return reinterpret_cast<T*>(&mStorage); }
+  bool isInline() const { return mpData==reinterpret_cast<const T*>(&mStorage); }
+
+  // doubles the capacity
+  void grow(){
+    reserve(mCapacity ? mCapacity*2 : 1);
+  }
+
+  typename std::aligned_storage<sizeof(T)*(N ? N : 1), alignof(T)>::type mStorage; // inline elements
+  T* mpData = inlineData();  // inline storage or heap
+  size_t mSize = 0;          // number of constructed elements
+  size_t mCapacity = N;      // elements mpData has room for
+};
+
+} // end namespace codepi
@@ -20,11 +20,45 @@
 #include "configurator.h"
 #include <fstream>
 #include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <atomic>
+#include <typeinfo>
 
 #ifdef __GNUC__
 #include <strings.h>
 #endif
 
+#if defined(__x86_64__) || defined(_M_X64)
+#define CFG_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#ifdef __GNUC__
+#define CFG_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CFG_TARGET_AVX2
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
 #define STR_DELIM ",#}]\t\r\n"
 
 using namespace std;
@@ -45,53 +79,1646 @@ public:
   size_t getSizeUsed(){
     return pptr() - pbase();
   }
+  void setInput(char* begin, char* pos, char* end){
+    setg(begin, pos, end);
+  }
+  char* getInputPos(){
+    return gptr();
+  }
 };
 
 /////////////////////////////////////////////////////
-// stripSpaces: Helper function
+// stripSpaces: Helper functions
+
+static bool isStripSpace(char c){
+  return c==' ' || c=='\t' || c=='\r' || c=='\n';
+}
+
+// narrows [a,b) to exclude leading and trailing spaces
+static void stripSpacesInPlace(const char*& a, const char*& b){
+  while(a<b && isStripSpace(*a)) a++;    //find first non-space
+  while(b>a && isStripSpace(b[-1])) b--; //find last non-space
+}
+
+static string stripSpaces(const char* a, const char* b){
+  stripSpacesInPlace(a,b);
+  return string(a,b); //get rid of leading or trailing spaces
+}
 
 static string stripSpaces(const string& in){
-  size_t a=in.find_first_not_of(" \t\r\n"); //find first non-space
-  size_t b=in.find_last_not_of(" \t\r\n"); //find last non-space
-  if(a==string::npos) return ""; //all white spaces
-  return in.substr(a,b-a+1); //get rid of leading or trailing spaces
+  return stripSpaces(in.data(), in.data()+in.size());
+}
+
+/////////////////////////////////////////////////////
+// readAll: Helper function, reads rest of stream into buf
+
+static void readAll(istream& is, string& buf){
+  if(!is) return;
+  char chunk[65536];
+  streamsize n;
+  while((n = is.rdbuf()->sgetn(chunk, sizeof(chunk))) > 0) buf.append(chunk, (size_t)n);
+  is.setstate(ios::eofbit);
+}
+
+// readBracketed: Helper function, reads a "{...}" or "[...]" value up to its
+//   closing bracket, so a stream that can't seek back (e.g. a pipe) is left
+//   just past it.  A value that doesn't start with a bracket, e.g. a top
+//   level struct, is read to the end of the stream
+
+static void readBracketed(istream& is, string& buf){
+  if(!is) return;
+  streambuf* sb = is.rdbuf(); // buffered, so reading a char at a time is cheap
+  int c;
+  while((c = sb->sgetc())!=EOF && CfgReader::isSpace(c)) { buf += (char)c; sb->sbumpc(); }
+  if(c!='{' && c!='[') { readAll(is, buf); return; }
+  int depth = 0;
+  while((c = sb->sbumpc())!=EOF){
+    buf += (char)c;
+    if(c=='{' || c=='[') depth++;
+    else if(c=='}' || c==']') { if(--depth==0) return; }
+    else if(c=='\\') { if((c = sb->sbumpc())!=EOF) buf += (char)c; }
+    else if(c=='#') { // comment, to end of line
+      while((c = sb->sbumpc())!=EOF && c!='\n') buf += (char)c;
+      if(c=='\n') buf += '\n';
+    }
+  }
+  is.setstate(ios::eofbit);
+}
+
+/////////////////////////////////////////////////////
+// MappedFile: Helper class for reading a whole file without copying
+// Maps the file read-only into memory.  Falls back to reading it into
+// a buffer if it can't be mapped (e.g. empty file, pipe, or /proc file).
+
+class MappedFile {
+public:
+  MappedFile(const string& filename) : mpData(NULL), mSize(0), mMapped(false), mOpen(false) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file==INVALID_HANDLE_VALUE) return;
+    mOpen = true;
+    LARGE_INTEGER size;
+    if(GetFileSizeEx(file, &size) && size.QuadPart>0){
+      HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+      if(mapping){
+        mpData = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping); // view keeps the mapping alive
+        if(mpData) { mSize = (size_t)size.QuadPart; mMapped = true; }
+      }
+    }
+    CloseHandle(file);
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd<0) return;
+    mOpen = true;
+    struct stat st;
+    if(fstat(fd, &st)==0 && S_ISREG(st.st_mode) && st.st_size>0){
+      void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(p!=MAP_FAILED) {
+        mpData = (const char*)p;
+        mSize = (size_t)st.st_size;
+        mMapped = true;
+        madvise(p, mSize, MADV_SEQUENTIAL);
+      }
+    }
+    close(fd);
+#endif
+    if(!mMapped){ // fall back to reading file into buffer
+      ifstream ifs(filename.c_str(), ios::binary);
+      readAll(ifs, mBuffer);
+      mpData = mBuffer.data();
+      mSize = mBuffer.size();
+    }
+  }
+
+  ~MappedFile(){
+    if(!mMapped) return;
+#ifdef _WIN32
+    UnmapViewOfFile(mpData);
+#else
+    munmap((void*)mpData, mSize);
+#endif
+  }
+
+  bool isOpen() const { return mOpen; }
+  const char* data() const { return mpData; }
+  size_t size() const { return mSize; }
+
+private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  const char* mpData;
+  size_t mSize;
+  bool mMapped, mOpen;
+  string mBuffer;
+};
+
+/////////////////////////////////////////////////////
+// CfgReader methods
+
+// istream over the reader's range, for parsing with operator>>
+class CfgReader::StreamAdapter {
+public:
+  StreamAdapter() : sb(NULL, 0), is(&sb) { is.imbue(locale::classic()); }
+  StreambufWrapper sb;
+  istream is;
+};
+
+/////////////////////////////////////////////////////
+// CfgWriter methods
+
+// ostream appending to the writer's buffer, for writing with operator<<
+// Collects output in a small put area that is moved to the buffer on sync.
+class CfgWriter::StreamAdapter {
+public:
+  class Buf : public streambuf {
+  public:
+    Buf(string& target) : target(target) { setp(area, area+sizeof(area)); }
+  protected:
+    int sync(){
+      target.append(pbase(), pptr()-pbase());
+      setp(area, area+sizeof(area));
+      return 0;
+    }
+    int_type overflow(int_type c){
+      sync();
+      if(!traits_type::eq_int_type(c, traits_type::eof())) target.push_back(traits_type::to_char_type(c));
+      return traits_type::not_eof(c);
+    }
+    streamsize xsputn(const char* s, streamsize n){
+      sync();
+      target.append(s, (size_t)n);
+      return n;
+    }
+  private:
+    string& target;
+    char area[256];
+  };
+
+  StreamAdapter(string& target, ostream* sink) : sb(target), os(&sb) {
+    if(sink) { // format like the sink would
+      os.flags(sink->flags());
+      os.precision(sink->precision());
+      os.fill(sink->fill());
+      os.imbue(sink->getloc());
+    }
+  }
+  Buf sb;
+  ostream os;
+};
+
+CfgWriter::CfgWriter(std::ostream* sink) : mSink(sink), mFail(false), mTagged(false) {}
+
+CfgWriter::~CfgWriter(){}
+
+void CfgWriter::writeIndent(int i){
+  static const char spaces[] = "                                                                ";
+  size_t n = i>0 ? 2*(size_t)i : 0;
+  while(n>0){
+    size_t chunk = min(n, sizeof(spaces)-1);
+    mBuffer.append(spaces, chunk);
+    n -= chunk;
+  }
+}
+
+bool CfgWriter::flush(){
+  if(!mSink) return !mFail;
+  if(!mBuffer.empty()){
+    mSink->write(mBuffer.data(), mBuffer.size());
+    mBuffer.clear();
+  }
+  mSink->flush();
+  if(mSink->fail()) mFail = true;
+  return !mFail;
+}
+
+void CfgWriter::endSized(size_t start){
+  size_t size = mBuffer.size()-start;
+  if(size<0x80) { mBuffer[start-1] = char(size); return; }
+  // prefix needs more than the one byte reserved, move the data up
+  char buf[10];
+  size_t n = 0;
+  while(size>=0x80) { buf[n++] = char(size|0x80); size >>= 7; }
+  buf[n++] = char(size);
+  mBuffer[start-1] = buf[0];
+  mBuffer.insert(start, buf+1, n-1);
+}
+
+std::ostream& CfgWriter::stream(){
+  if(!mpStream) mpStream.reset(new StreamAdapter(mBuffer, mSink));
+  mpStream->os.clear();
+  return mpStream->os;
+}
+
+void CfgWriter::syncFromStream(){
+  mpStream->os.flush();
+}
+
+/////////////////////////////////////////////////////
+// Number formatting
+// Integers are written two digits at a time.  Floating point uses Grisu2
+// (Loitsch, "Printing Floating-Point Numbers Quickly and Accurately"),
+// which finds the shortest digits inside the value's rounding interval
+// using 64 bit integer math, so the output always reads back exactly.
+
+// "00" to "99"
+static const char gDigitPairs[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+// writes magnitude backwards ending at end, returns start
+static char* formatInteger(unsigned long long magnitude, char* end){
+  char* p = end;
+  while(magnitude>=100){
+    unsigned r = (unsigned)(magnitude%100);
+    magnitude /= 100;
+    p -= 2;
+    memcpy(p, gDigitPairs+2*r, 2);
+  }
+  if(magnitude>=10){
+    p -= 2;
+    memcpy(p, gDigitPairs+2*magnitude, 2);
+  } else *--p = char('0'+magnitude);
+  return p;
+}
+
+// floating point value f*2^e, with 64 bit significand
+struct DiyFp {
+  unsigned long long f;
+  int e;
+  DiyFp(unsigned long long f=0, int e=0) : f(f), e(e) {}
+  DiyFp operator-(const DiyFp& rhs) const { return DiyFp(f-rhs.f, e); }
+  DiyFp operator*(const DiyFp& rhs) const {
+    // upper 64 bits of 128 bit product, rounded
+    const unsigned long long M32 = 0xFFFFFFFFULL;
+    unsigned long long a = f>>32, b = f&M32, c = rhs.f>>32, d = rhs.f&M32;
+    unsigned long long ac = a*c, bc = b*c, ad = a*d, bd = b*d;
+    unsigned long long tmp = (bd>>32) + (ad&M32) + (bc&M32) + (1ULL<<31);
+    return DiyFp(ac + (ad>>32) + (bc>>32) + (tmp>>32), e+rhs.e+64);
+  }
+  DiyFp normalize() const {
+    DiyFp r = *this;
+    while(!(r.f & 0xFFC0000000000000ULL)) { r.f <<= 10; r.e -= 10; }
+    while(!(r.f & 0x8000000000000000ULL)) { r.f <<= 1;  r.e -= 1; }
+    return r;
+  }
+};
+
+// normalized 10^k for k = -348, -340, ..., 340
+static const unsigned long long gCachedPowersF[] = {
+  0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+  0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+  0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+  0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+  0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+  0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+  0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+  0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+  0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+  0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+  0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+  0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+  0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+  0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+  0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+  0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+  0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+  0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+  0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+  0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+  0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+  0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+static const short gCachedPowersE[] = {
+  -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+  -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+  -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+  -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+  56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+  375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+  694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+  1013, 1039, 1066
+};
+
+// cached power c = 10^-K, such that c*2^e has a binary exponent in [-60,-32]
+static DiyFp getCachedPower(int e, int& K){
+  double dk = (-61-e)*0.30102999566398114 + 347;
+  int k = (int)dk;
+  if(dk-k > 0.0) k++;
+  unsigned index = (unsigned)((k>>3)+1);
+  K = -(-348 + (int)(index<<3));
+  return DiyFp(gCachedPowersF[index], gCachedPowersE[index]);
+}
+
+// moves last digit closer to w while staying inside the interval
+static void grisuRound(char* digits, int len, unsigned long long delta, unsigned long long rest,
+                       unsigned long long tenKappa, unsigned long long wpw){
+  while(rest<wpw && delta-rest>=tenKappa &&
+        (rest+tenKappa<wpw || wpw-rest>rest+tenKappa-wpw)){
+    digits[len-1]--;
+    rest += tenKappa;
+  }
+}
+
+// generates shortest digits of w inside (mp-delta, mp], value is digits*10^K
+// Sets nearBoundary if a decimal one digit shorter lies so close to the
+//   interval that the rounding error of the 64 bit math could have excluded it.
+static void grisuDigits(const DiyFp& w, const DiyFp& mp, unsigned long long delta, char* digits, int& len, int& K,
+                        bool& nearBoundary){
+  static const unsigned long long pow10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL
+  };
+  const unsigned long long ERROR_MARGIN = 4; // in units of the last bit of mp
+  const DiyFp one(1ULL << -mp.e, mp.e);
+  const DiyFp wpw = mp - w;
+  unsigned p1 = (unsigned)(mp.f >> -one.e);  // integer part
+  unsigned long long p2 = mp.f & (one.f-1);  // fractional part
+  int kappa = 1;
+  while(kappa<10 && p1>=pow10[kappa]) kappa++;
+  len = 0;
+  nearBoundary = false;
+  while(kappa>0){
+    unsigned d = p1/(unsigned)pow10[kappa-1];
+    p1 %= (unsigned)pow10[kappa-1];
+    if(d || len) digits[len++] = char('0'+d);
+    kappa--;
+    unsigned long long tmp = ((unsigned long long)p1 << -one.e) + p2;
+    unsigned long long tenKappa = pow10[kappa] << -one.e;
+    if(tmp<=delta){
+      K += kappa;
+      grisuRound(digits, len, delta, tmp, tenKappa, wpw.f);
+      return;
+    }
+    nearBoundary = tmp-delta<=ERROR_MARGIN || tenKappa-tmp<=ERROR_MARGIN;
+  }
+  for(;;){
+    p2 *= 10;
+    delta *= 10;
+    char d = char(p2 >> -one.e);
+    if(d || len) digits[len++] = char('0'+d);
+    p2 &= one.f-1;
+    kappa--;
+    int index = -kappa;
+    if(p2<delta){
+      K += kappa;
+      grisuRound(digits, len, delta, p2, one.f, wpw.f * (index<20 ? pow10[index] : 0));
+      return;
+    }
+    // the error is scaled by 10 each digit, like delta
+    unsigned long long margin = index<19 ? ERROR_MARGIN*pow10[index] : ~0ULL;
+    nearBoundary = p2-delta<=margin || one.f-p2<=margin;
+  }
+}
+
+// unsigned integer of up to 1536 bits, for exact comparisons
+// between decimal and binary values, when writing and reading numbers
+class BigInt {
+public:
+  BigInt(unsigned long long val) : size(0) {
+    while(val) { words[size++] = (unsigned)val; val >>= 32; }
+  }
+  void mulSmall(unsigned m){
+    unsigned long long carry = 0;
+    for(int i=0; i<size; i++){
+      carry += (unsigned long long)words[i]*m;
+      words[i] = (unsigned)carry;
+      carry >>= 32;
+    }
+    if(carry) words[size++] = (unsigned)carry;
+  }
+  void mulPow5(int n){
+    for(; n>=13; n-=13) mulSmall(1220703125U); // 5^13
+    unsigned m = 1;
+    for(; n>0; n--) m *= 5;
+    mulSmall(m);
+  }
+  void shiftLeft(int n){
+    if(!size) return;
+    int wordShift = n/32, bitShift = n%32;
+    words[size+wordShift] = 0;
+    for(int i=size-1; i>=0; i--){
+      unsigned long long w = (unsigned long long)words[i] << bitShift;
+      words[i+wordShift+1] |= (unsigned)(w>>32);
+      words[i+wordShift] = (unsigned)w;
+    }
+    for(int i=0; i<wordShift; i++) words[i] = 0;
+    size += wordShift+1;
+    while(size && !words[size-1]) size--;
+  }
+  static int compare(const BigInt& a, const BigInt& b){
+    if(a.size!=b.size) return a.size<b.size ? -1 : 1;
+    for(int i=a.size-1; i>=0; i--)
+      if(a.words[i]!=b.words[i]) return a.words[i]<b.words[i] ? -1 : 1;
+    return 0;
+  }
+private:
+  unsigned words[48];
+  int size;
+};
+
+// sign of d*10^k - b*2^j
+static int compareDecimalBinary(unsigned long long d, int k, unsigned long long b, int j){
+  BigInt lhs(d), rhs(b);
+  if(k>=0) lhs.mulPow5(k);
+  else     rhs.mulPow5(-k);
+  if(k>j) lhs.shiftLeft(k-j);
+  else    rhs.shiftLeft(j-k);
+  return BigInt::compare(lhs, rhs);
+}
+
+// Removes digits while the shorter decimal still rounds to f*2^e, using exact math.
+// lowerB*2^lowerE and (2f+1)*2^(e-1) are the bounds of the rounding interval.
+static void shortenExact(unsigned long long f, int e, unsigned long long lowerB, int lowerE,
+                         char* digits, int& len, int& K){
+  bool inclusive = (f%2)==0; // ties round to even
+  unsigned long long d = 0;
+  for(int i=0; i<len; i++) d = d*10 + (digits[i]-'0');
+  bool changed = false;
+  while(d>=10){
+    unsigned long long lo = d/10, hi = lo+1;
+    int cmpLo = compareDecimalBinary(lo, K+1, lowerB, lowerE);
+    int cmpHi = compareDecimalBinary(hi, K+1, 2*f+1, e-1);
+    bool loIn = cmpLo>0 || (inclusive && cmpLo==0);
+    bool hiIn = cmpHi<0 || (inclusive && cmpHi==0);
+    if(!loIn && !hiIn) break;
+    if(loIn && hiIn){ // take the closer one, comparing their midpoint with f*2^e
+      int cmpMid = compareDecimalBinary(2*lo+1, K+1, f, e+1);
+      d = (cmpMid>0 || (cmpMid==0 && lo%2==0)) ? lo : hi;
+    } else d = loIn ? lo : hi;
+    K++;
+    changed = true;
+  }
+  if(!changed) return;
+  while(d%10==0) { d /= 10; K++; }
+  char buf[24];
+  char* end = buf+sizeof(buf);
+  char* p = formatInteger(d, end);
+  len = (int)(end-p);
+  memcpy(digits, p, len);
+}
+
+// shortest digits of f*2^e, where hiddenBit is the implicit leading bit of
+//   the type's significand and minExp the exponent of subnormals
+static void grisu2(unsigned long long f, int e, unsigned long long hiddenBit, int minExp,
+                   char* digits, int& len, int& K){
+  DiyFp v(f, e);
+  DiyFp mp = DiyFp((f<<1)+1, e-1).normalize();
+  // a power of 2 significand has a closer lower neighbor, except at the smallest exponent
+  bool asymmetric = f==hiddenBit && e>minExp;
+  DiyFp mm = asymmetric ? DiyFp((f<<2)-1, e-2) : DiyFp((f<<1)-1, e-1);
+  mm.f <<= mm.e-mp.e;
+  mm.e = mp.e;
+  const DiyFp c = getCachedPower(mp.e, K);
+  const DiyFp w = v.normalize()*c;
+  DiyFp wp = mp*c, wm = mm*c;
+  wm.f++;
+  wp.f--;
+  bool nearBoundary;
+  grisuDigits(w, wp, wp.f-wm.f, digits, len, K, nearBoundary);
+  // the interval was shrunk by the error bound, a shorter decimal may still fit
+  if(nearBoundary){
+    if(asymmetric) shortenExact(f, e, (f<<2)-1, e-2, digits, len, K);
+    else           shortenExact(f, e, (f<<1)-1, e-1, digits, len, K);
+  }
+}
+
+// writes digits*10^K, in fixed notation if the decimal exponent is in
+//   [-4,17) and in exponential notation otherwise, like %g
+static size_t formatDecimal(bool neg, const char* digits, int len, int K, char* buf){
+  char* p = buf;
+  if(neg) *p++ = '-';
+  int point = len+K; // position of decimal point relative to digits
+  if(point>-4 && point<=17){
+    if(point<=0){ // 0.00123
+      *p++ = '0';
+      *p++ = '.';
+      for(int i=point; i<0; i++) *p++ = '0';
+      memcpy(p, digits, len);
+      p += len;
+    } else if(point<len){ // 12.3
+      memcpy(p, digits, point);
+      p += point;
+      *p++ = '.';
+      memcpy(p, digits+point, len-point);
+      p += len-point;
+    } else { // 12300
+      memcpy(p, digits, len);
+      p += len;
+      for(int i=len; i<point; i++) *p++ = '0';
+    }
+  } else { // 1.23e+45
+    *p++ = digits[0];
+    if(len>1){
+      *p++ = '.';
+      memcpy(p, digits+1, len-1);
+      p += len-1;
+    }
+    int exp = point-1;
+    *p++ = 'e';
+    *p++ = exp<0 ? '-' : '+';
+    if(exp<0) exp = -exp;
+    if(exp>=100) { *p++ = char('0'+exp/100); exp %= 100; }
+    memcpy(p, gDigitPairs+2*exp, 2);
+    p += 2;
+  }
+  return p-buf;
+}
+
+void CfgWriter::writeInteger(unsigned long long magnitude, bool negative){
+  char buf[24];
+  char* end = buf+sizeof(buf);
+  char* p = formatInteger(magnitude, end);
+  if(negative) *--p = '-';
+  mBuffer.append(p, end-p);
+}
+
+// writes special values and zero, returns false for other values
+static bool writeSpecial(string& out, bool neg, bool isInf, bool isNan, bool isZero){
+  if(isNan)       out.append("nan");
+  else if(isInf)  out.append(neg ? "-inf" : "inf");
+  else if(isZero) out.append(neg ? "-0" : "0");
+  else return false;
+  return true;
+}
+
+void CfgWriter::writeNumber(double val){
+  unsigned long long bits;
+  memcpy(&bits, &val, sizeof(bits));
+  const unsigned long long hiddenBit = 1ULL<<52;
+  bool neg = (bits>>63)!=0;
+  int biasedExp = (int)((bits>>52) & 0x7FF);
+  unsigned long long f = bits & (hiddenBit-1);
+  if(writeSpecial(mBuffer, neg, biasedExp==0x7FF && f==0, biasedExp==0x7FF && f!=0, biasedExp==0 && f==0)) return;
+  int e;
+  if(biasedExp) { f += hiddenBit; e = biasedExp-1075; }
+  else e = -1074;  // subnormal
+
+  char digits[20], buf[32];
+  int len, K;
+  grisu2(f, e, hiddenBit, -1074, digits, len, K);
+  mBuffer.append(buf, formatDecimal(neg, digits, len, K, buf));
+}
+
+void CfgWriter::writeNumber(float val){
+  unsigned bits;
+  memcpy(&bits, &val, sizeof(bits));
+  const unsigned hiddenBit = 1U<<23;
+  bool neg = (bits>>31)!=0;
+  int biasedExp = (int)((bits>>23) & 0xFF);
+  unsigned f = bits & (hiddenBit-1);
+  if(writeSpecial(mBuffer, neg, biasedExp==0xFF && f==0, biasedExp==0xFF && f!=0, biasedExp==0 && f==0)) return;
+  int e;
+  if(biasedExp) { f += hiddenBit; e = biasedExp-150; }
+  else e = -149;  // subnormal
+
+  char digits[20], buf[32];
+  int len, K;
+  grisu2(f, e, hiddenBit, -149, digits, len, K);
+  mBuffer.append(buf, formatDecimal(neg, digits, len, K, buf));
+}
+
+/////////////////////////////////////////////////////
+// Scanners: find the first char of a class, 16 or 32 bytes at a time
+// Each char class has a scalar test and SSE2/AVX2 versions that return
+// a byte mask of matching chars.  The best version for the cpu is
+// chosen on first use.
+
+static bool isStrDelim(char c){
+  // true if c is in STR_DELIM
+  switch(c){
+  case ',': case '#': case '}': case ']': case '\t': case '\r': case '\n':
+    return true;
+  default:
+    return false;
+  }
+}
+
+// matches string delimiters and '\\'
+struct StrDelimClass {
+  static bool match(char c) { return isStrDelim(c) || c=='\\'; }
+#ifdef CFG_SIMD_X86
+  static __m128i match16(__m128i x) {
+    __m128i m = _mm_cmpeq_epi8(x, _mm_set1_epi8(','));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8('#')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8('}')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8(']')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8('\t')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8('\r')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8('\n')));
+    return _mm_or_si128(m, _mm_cmpeq_epi8(x, _mm_set1_epi8('\\')));
+  }
+  CFG_TARGET_AVX2 static __m256i match32(__m256i x) {
+    __m256i m = _mm256_cmpeq_epi8(x, _mm256_set1_epi8(','));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, _mm256_set1_epi8('#')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, _mm256_set1_epi8('}')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, _mm256_set1_epi8(']')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\t')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\r')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')));
+    return _mm256_or_si256(m, _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\\')));
+  }
+#endif
+};
+
+// matches anything but whitespace: ' ' and \t\n\v\f\r (9-13)
+struct NonSpaceClass {
+  static bool match(char c) { return !CfgReader::isSpace(c); }
+#ifdef CFG_SIMD_X86
+  static __m128i spaces16(__m128i x) {
+    __m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(_mm_max_epu8(x, _mm_set1_epi8(9)), _mm_set1_epi8(13)), x);
+    return _mm_or_si128(ctrl, _mm_cmpeq_epi8(x, _mm_set1_epi8(' ')));
+  }
+  static __m128i match16(__m128i x) {
+    return _mm_xor_si128(spaces16(x), _mm_set1_epi8(-1));
+  }
+  CFG_TARGET_AVX2 static __m256i spaces32(__m256i x) {
+    __m256i ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_max_epu8(x, _mm256_set1_epi8(9)), _mm256_set1_epi8(13)), x);
+    return _mm256_or_si256(ctrl, _mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')));
+  }
+  CFG_TARGET_AVX2 static __m256i match32(__m256i x) {
+    return _mm256_xor_si256(spaces32(x), _mm256_set1_epi8(-1));
+  }
+#endif
+};
+
+// matches anything but whitespace and ','
+struct NonSeparatorClass {
+  static bool match(char c) { return !CfgReader::isSpace(c) && c!=','; }
+#ifdef CFG_SIMD_X86
+  static __m128i match16(__m128i x) {
+    __m128i sep = _mm_or_si128(NonSpaceClass::spaces16(x), _mm_cmpeq_epi8(x, _mm_set1_epi8(',')));
+    return _mm_xor_si128(sep, _mm_set1_epi8(-1));
+  }
+  CFG_TARGET_AVX2 static __m256i match32(__m256i x) {
+    __m256i sep = _mm256_or_si256(NonSpaceClass::spaces32(x), _mm256_cmpeq_epi8(x, _mm256_set1_epi8(',')));
+    return _mm256_xor_si256(sep, _mm256_set1_epi8(-1));
+  }
+#endif
+};
+
+template <typename Class>
+static const char* scanScalar(const char* p, const char* end){
+  while(p<end && !Class::match(*p)) p++;
+  return p;
+}
+
+#ifdef CFG_SIMD_X86
+static unsigned firstBit(unsigned mask){
+  // index of lowest set bit, mask must be non-zero
+#ifdef _MSC_VER
+  unsigned long i;
+  _BitScanForward(&i, mask);
+  return i;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+template <typename Class>
+static const char* scanSse2(const char* p, const char* end){
+  for(; end-p>=16; p+=16){
+    unsigned mask = _mm_movemask_epi8(Class::match16(_mm_loadu_si128((const __m128i*)p)));
+    if(mask) return p+firstBit(mask);
+  }
+  return scanScalar<Class>(p, end);
+}
+
+template <typename Class>
+CFG_TARGET_AVX2 static const char* scanAvx2(const char* p, const char* end){
+  for(; end-p>=32; p+=32){
+    unsigned mask = _mm256_movemask_epi8(Class::match32(_mm256_loadu_si256((const __m256i*)p)));
+    if(mask) return p+firstBit(mask);
+  }
+  if(end-p>=16){
+    unsigned mask = _mm_movemask_epi8(Class::match16(_mm_loadu_si128((const __m128i*)p)));
+    if(mask) return p+firstBit(mask);
+    p+=16;
+  }
+  return scanScalar<Class>(p, end);
+}
+
+static bool cpuHasAvx2(){
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if(info[0]<7) return false;
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1<<27))!=0;
+  if(!osxsave || (_xgetbv(0) & 6)!=6) return false; // OS saves ymm registers
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1<<5))!=0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+typedef const char* (*ScanFunc)(const char*, const char*);
+
+struct Scanners {
+  ScanFunc nonSpace, nonSeparator, strDelim;
+};
+
+static const Scanners& scanners(){
+  // choose best implementation on first use
+  struct Chooser {
+    static Scanners choose(){
+#ifdef CFG_SIMD_X86
+      if(cpuHasAvx2()){
+        Scanners s = { scanAvx2<NonSpaceClass>, scanAvx2<NonSeparatorClass>, scanAvx2<StrDelimClass> };
+        return s;
+      }
+      Scanners s = { scanSse2<NonSpaceClass>, scanSse2<NonSeparatorClass>, scanSse2<StrDelimClass> };
+#else
+      Scanners s = { scanScalar<NonSpaceClass>, scanScalar<NonSeparatorClass>, scanScalar<StrDelimClass> };
+#endif
+      return s;
+    }
+  };
+  static const Scanners s = Chooser::choose();
+  return s;
+}
+
+const char* CfgReader::scanNonSpace(const char* p, const char* end){
+  return scanners().nonSpace(p, end);
+}
+
+const char* CfgReader::scanNonSeparator(const char* p, const char* end){
+  return scanners().nonSeparator(p, end);
+}
+
+const char* CfgReader::scanStrDelim(const char* p, const char* end){
+  return scanners().strDelim(p, end);
+}
+
+CfgReader::CfgReader(const char* begin, const char* end)
+  : mBegin(begin), mPos(begin), mEnd(end), mFail(false), mTagged(false), mParseThreads(1) {}
+
+CfgReader::~CfgReader(){}
+
+std::istream& CfgReader::stream(){
+  if(!mpStream) mpStream.reset(new StreamAdapter);
+  mpStream->sb.setInput((char*)mBegin, (char*)mPos, (char*)mEnd);
+  mpStream->is.clear();
+  return mpStream->is;
+}
+
+void CfgReader::syncFromStream(){
+  mPos = mpStream->sb.getInputPos();
+  if(mpStream->is.fail()) mFail = true;
+}
+
+static int digitValue(char c){
+  // returns value of hex digit, or 16 if not a digit
+  if(c>='0' && c<='9') return c-'0';
+  if(c>='a' && c<='f') return c-'a'+10;
+  if(c>='A' && c<='F') return c-'A'+10;
+  return 16;
+}
+
+bool CfgReader::readInteger(unsigned long long& magnitude, bool& negative){
+  skipSpaces();
+  const char* p = mPos;
+  negative = false;
+  if(p<mEnd && (*p=='-' || *p=='+')) negative = (*p++=='-');
+
+  // base prefix, as with std::setbase(0)
+  unsigned base = 10;
+  bool digits = false;
+  if(p<mEnd && *p=='0'){
+    p++;
+    if(p<mEnd && (*p=='x' || *p=='X')) { base = 16; p++; }
+    else { base = 8; digits = true; }
+  }
+
+  unsigned long long val = 0;
+  const unsigned long long maxVal = ~0ULL;
+  bool overflow = false;
+  for(; p<mEnd; p++){
+    unsigned d = digitValue(*p);
+    if(d>=base) break;
+    if(val > (maxVal-d)/base) overflow = true;
+    val = val*base + d;
+    digits = true;
+  }
+  mPos = p;
+  magnitude = val;
+  return digits && !overflow;
+}
+
+// exactly representable powers of 10
+static const double gPow10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static bool matchWord(const char* p, const char* end, const char* word){
+  // case insensitive compare of [p,end) prefix with word
+  for(; *word; p++, word++){
+    if(p>=end || tolower((unsigned char)*p)!=*word) return false;
+  }
+  return true;
+}
+
+// Correctly rounded mantissa*10^exponent, for values the double fast path
+// can't convert exactly.  Starts from an estimate within a few ulps and steps
+// to the neighbor until the decimal is inside the double's rounding interval.
+static double exactDouble(unsigned long long mantissa, int exponent){
+  const unsigned long long hiddenBit = 1ULL<<52;
+  double val = (double)mantissa * pow(10.0, exponent);
+  for(;;){
+    unsigned long long bits;
+    memcpy(&bits, &val, sizeof(bits));
+    int biasedExp = (int)(bits>>52);
+    unsigned long long f = bits & (hiddenBit-1);
+    int e;
+    if(biasedExp) { f += hiddenBit; e = biasedExp-1075; }
+    else e = -1074;
+    bool even = (f%2)==0; // ties round to even
+    int cmpHi = compareDecimalBinary(mantissa, exponent, 2*f+1, e-1);
+    if(cmpHi>0 || (cmpHi==0 && !even)) {
+      val = nextafter(val, numeric_limits<double>::infinity());
+      continue;
+    }
+    int cmpLo = (f==hiddenBit && biasedExp>1) ? compareDecimalBinary(mantissa, exponent, 4*f-1, e-2)
+                                              : compareDecimalBinary(mantissa, exponent, 2*f-1, e-1);
+    if(cmpLo<0 || (cmpLo==0 && !even)) {
+      val = nextafter(val, 0.0);
+      continue;
+    }
+    return val;
+  }
+}
+
+// Scans a floating point number.  If it can be converted exactly, sets val
+// and returns 1.  Up to 15 significant digits and 10^22 use double
+// arithmetic, up to 19 digits use exactDouble.  Returns 0 if a valid number
+// that needs the slow path, -1 if invalid.  Either way, *pEnd is set to the
+// end of the number.
+static int scanDouble(const char* p, const char* end, const char** pEnd, double& val){
+  bool neg = false;
+  if(p<end && (*p=='-' || *p=='+')) neg = (*p++=='-');
+
+  // inf and nan
+  if(p<end && (*p=='i' || *p=='I' || *p=='n' || *p=='N')){
+    if(matchWord(p, end, "infinity")) { *pEnd = p+8; val = numeric_limits<double>::infinity(); }
+    else if(matchWord(p, end, "inf")) { *pEnd = p+3; val = numeric_limits<double>::infinity(); }
+    else if(matchWord(p, end, "nan")) { *pEnd = p+3; val = numeric_limits<double>::quiet_NaN(); }
+    else { *pEnd = p; return -1; }
+    if(neg) val = -val;
+    return 1;
+  }
+
+  // mantissa
+  unsigned long long mantissa = 0;
+  int exponent = 0, sigDigits = 0;
+  bool digits = false, truncated = false;
+  for(; p<end && *p>='0' && *p<='9'; p++){
+    digits = true;
+    if(mantissa==0 && *p=='0') continue;
+    if(sigDigits<19) { mantissa = mantissa*10 + (*p-'0'); sigDigits++; }
+    else { exponent++; truncated |= *p!='0'; }
+  }
+  if(p<end && *p=='.'){
+    for(p++; p<end && *p>='0' && *p<='9'; p++){
+      digits = true;
+      if(mantissa==0 && *p=='0') { exponent--; continue; }
+      if(sigDigits<19) { mantissa = mantissa*10 + (*p-'0'); sigDigits++; exponent--; }
+      else truncated |= *p!='0';
+    }
+  }
+  if(!digits) { *pEnd = p; return -1; }
+
+  // exponent
+  if(p<end && (*p=='e' || *p=='E')){
+    p++;
+    bool expNeg = false;
+    if(p<end && (*p=='-' || *p=='+')) expNeg = (*p++=='-');
+    if(p>=end || *p<'0' || *p>'9') { *pEnd = p; return -1; }
+    int e = 0;
+    for(; p<end && *p>='0' && *p<='9'; p++) if(e<100000) e = e*10 + (*p-'0');
+    exponent += expNeg ? -e : e;
+  }
+  *pEnd = p;
+
+  if(mantissa==0) { val = neg ? -0.0 : 0.0; return 1; }
+  if(sigDigits<=15 && exponent>=-22 && exponent<=22) {
+    val = (double)mantissa;
+    if(exponent<0) val /= gPow10[-exponent];
+    else           val *= gPow10[exponent];
+  } else {
+    // digits beyond 19, and values near overflow or underflow, need slow path
+    if(truncated || exponent<-300 || exponent+sigDigits>308) return 0;
+    val = exactDouble(mantissa, exponent);
+  }
+  if(neg) val = -val;
+  return 1;
+}
+
+bool CfgReader::readNumber(double& val){
+  skipSpaces();
+  const char* end;
+  int rc = scanDouble(mPos, mEnd, &end, val);
+  if(rc==0) { // valid but not exact in double arithmetic, use operator>>
+    stream() >> val;
+    syncFromStream();
+    return !mFail;
+  }
+  mPos = end;
+  return rc==1;
+}
+
+bool CfgReader::readNumber(float& val){
+  skipSpaces();
+  const char* end;
+  double d;
+  int rc = scanDouble(mPos, mEnd, &end, d);
+  if(rc==1 && d==d && d!=0 && fabs(d)<numeric_limits<double>::infinity() &&
+     (fabs(d)>numeric_limits<float>::max() || fabs(d)<numeric_limits<float>::min()))
+    rc = 0; // out of float range, let operator>> decide
+  if(rc==1 && d==d && d!=(double)(float)d) {
+    // rounding d to float is only exact if d isn't halfway between two floats
+    float lo = (float)d, hi = lo;
+    if((double)lo<d) hi = nextafterf(lo, numeric_limits<float>::infinity());
+    else             lo = nextafterf(hi, -numeric_limits<float>::infinity());
+    if(d-(double)lo == (double)hi-d) rc = 0;
+  }
+  if(rc==0) { // valid but not exact in double arithmetic, use operator>>
+    stream() >> val;
+    syncFromStream();
+    return !mFail;
+  }
+  mPos = end;
+  if(rc==1) val = (float)d;
+  return rc==1;
+}
+
+CfgIStreamReader::CfgIStreamReader(istream& is) : mIs(is) {
+  mStart = is ? is.tellg() : streampos(-1);
+  // the unparsed part can only be given back if the stream can seek
+  if(mStart!=streampos(-1)) readAll(is, mBuffer);
+  else readBracketed(is, mBuffer);
+  reset(mBuffer.data(), mBuffer.data()+mBuffer.size());
+}
+
+CfgIStreamReader::~CfgIStreamReader(){
+  // put back the unparsed part of the stream, if possible
+  size_t used = pos()-begin();
+  if(fail()) mIs.setstate(ios::failbit);
+  else if(used<mBuffer.size() && mStart!=streampos(-1)) {
+    mIs.clear();
+    mIs.seekg(mStart+streamoff(used));
+  }
 }
 
 /////////////////////////////////////////////////////
 // Configurator methods
 
+// files read by readFile on this thread, see readFile(filename, filesRead)
+static thread_local vector<string>* gFilesRead = NULL;
+
+// sets gFilesRead, and restores it also if reading throws
+struct TrackFilesRead{
+  vector<string>* prev;
+  TrackFilesRead(vector<string>* files) : prev(gFilesRead) { gFilesRead = files; }
+  ~TrackFilesRead() { gFilesRead = prev; }
+};
+
+// Loads the files named by "include = filename" ahead of parsing, on several
+// threads, see setPrefetchIncludes.  Each loaded file is scanned for its own
+// includes, which also pages it in.  The scan is a heuristic: an include it
+// misses is read when it is parsed, and a file it finds that isn't really
+// included is loaded for nothing.
+class IncludePrefetcher{
+public:
+  IncludePrefetcher(const char* begin, const char* end) : mStop(false) {
+    vector<string> names;
+    scanIncludes(begin, end, names);
+    lock_guard<mutex> lock(mMutex);
+    enqueue(names);
+  }
+
+  ~IncludePrefetcher(){
+    {
+      lock_guard<mutex> lock(mMutex);
+      mStop = true;
+    }
+    mCond.notify_all();
+    for(size_t i=0; i<mThreads.size(); i++) mThreads[i].join();
+  }
+
+  /// the loaded file, loading it now or waiting for it if needed.  NULL if
+  ///   the scan didn't find filename
+  shared_ptr<MappedFile> get(const string& filename){
+    unique_lock<mutex> lock(mMutex);
+    map<string,Entry>::iterator entry = mFiles.find(filename);
+    if(entry==mFiles.end()) return shared_ptr<MappedFile>();
+    if(entry->second.state==QUEUED){ // not started yet, load it here
+      mQueue.erase(find(mQueue.begin(), mQueue.end(), filename));
+      load(filename, lock);
+    }
+    mCond.wait(lock, [&]{ return entry->second.state==DONE; });
+    return entry->second.file;
+  }
+
+  /// maximum number of threads loading files
+  static const size_t THREADS = 8;
+
+private:
+  IncludePrefetcher(const IncludePrefetcher&);
+  IncludePrefetcher& operator=(const IncludePrefetcher&);
+
+  enum State { QUEUED, LOADING, DONE };
+  struct Entry{
+    Entry() : state(QUEUED) {}
+    State state;
+    shared_ptr<MappedFile> file;
+  };
+
+  /// finds the values of "include" and "a.b.include" keys
+  static void scanIncludes(const char* begin, const char* end, vector<string>& names){
+    static const char key[] = "include";
+    const char* p = begin;
+    while((p = search(p, end, key, key+sizeof(key)-1))!=end){
+      const char* match = p;
+      p += sizeof(key)-1;
+      char prev = match==begin ? '\n' : match[-1];
+      if(!CfgReader::isSpace(prev) && prev!='{' && prev!='.' && prev!=',') continue;
+      const char* lineStart = match;
+      while(lineStart>begin && lineStart[-1]!='\n') lineStart--;
+      if(memchr(lineStart, '#', match-lineStart)) continue; // in a comment
+
+      const char* q = p;
+      while(q<end && (*q==' ' || *q=='\t')) q++;
+      if(q==end || *q!='=') continue;
+      q++;
+      const char* start = q;
+      while(q<end && !isStrDelim(*q) && *q!='\\') q++;
+      if(q<end && *q=='\\') continue; // escaped names are left to the parser
+      string name = stripSpaces(start, q);
+      if(!name.empty()) names.push_back(name);
+    }
+  }
+
+  /// adds names not seen yet to the queue, called with mMutex held
+  void enqueue(const vector<string>& names){
+    for(size_t i=0; i<names.size(); i++){
+      if(mFiles.count(names[i])) continue;
+      mFiles[names[i]];
+      mQueue.push_back(names[i]);
+      if(!mStop && mThreads.size()<THREADS && mThreads.size()<mFiles.size()){
+        try{
+          mThreads.push_back(thread(&IncludePrefetcher::run, this));
+        }catch(std::system_error&){
+          // get() loads the files no thread took
+        }
+      }
+    }
+    mCond.notify_all();
+  }
+
+  /// loads filename and queues the files it includes, lock is held on entry and exit
+  void load(const string& filename, unique_lock<mutex>& lock){
+    mFiles[filename].state = LOADING;
+    lock.unlock();
+    shared_ptr<MappedFile> file = make_shared<MappedFile>(filename);
+    vector<string> names;
+    if(file->isOpen()) scanIncludes(file->data(), file->data()+file->size(), names);
+    lock.lock();
+    mFiles[filename].file = file;
+    mFiles[filename].state = DONE;
+    enqueue(names);
+  }
+
+  void run(){
+    unique_lock<mutex> lock(mMutex);
+    while(true){
+      mCond.wait(lock, [this]{ return mStop || !mQueue.empty(); });
+      if(mStop) return;
+      string filename = mQueue.front();
+      mQueue.pop_front();
+      load(filename, lock);
+    }
+  }
+
+  mutex mMutex;  // guards all members.  mThreads doesn't change once mStop is set
+  condition_variable mCond;
+  map<string,Entry> mFiles;
+  deque<string> mQueue;
+  vector<thread> mThreads;
+  bool mStop;
+};
+
+// prefetching includes, see setPrefetchIncludes
+static atomic<bool> gPrefetchIncludes(false);
+// includes being prefetched for the read on this thread
+static thread_local IncludePrefetcher* gIncludes = NULL;
+
+// prefetches the includes of [begin,end) if enabled and not already
+// prefetching, i.e. for the file or string read first
+struct PrefetchScope{
+  unique_ptr<IncludePrefetcher> prefetcher;
+  PrefetchScope(const char* begin, const char* end){
+    if(!gPrefetchIncludes || gIncludes) return;
+    prefetcher.reset(new IncludePrefetcher(begin, end));
+    gIncludes = prefetcher.get();
+  }
+  ~PrefetchScope(){ if(prefetcher) gIncludes = NULL; }
+};
+
+void Configurator::setPrefetchIncludes(bool prefetch){
+  gPrefetchIncludes = prefetch;
+}
+
+bool Configurator::getPrefetchIncludes(){
+  return gPrefetchIncludes;
+}
+
+// 64-bit FNV-1a hash of [p,end), for comparing texts without keeping them
+static unsigned long long textHash(const char* p, const char* end){
+  unsigned long long hash = 14695981039346656037ull;
+  for(; p<end; p++) hash = (hash ^ (unsigned char)*p) * 1099511628211ull;
+  return hash;
+}
+
+// Entries of a file as parsed by one struct type, see IncludeCache.  An entry
+// whose member is replaced by setting it (CfgSetReplaces) keeps a copy of its
+// value, an entry of a nested struct keeps the entries of that struct, and
+// other entries (includes, "a.b" keys, Lazy, ...) keep their text, to be set
+// from it again.
+struct CfgCachedEntries{
+  struct Entry{
+    string key;
+    const Configurator::CfgKeyEntry* keyEntry;  // NULL if key isn't a member, e.g. "include"
+    size_t valueSize;         // bytes of text the value was read from
+    size_t size;              // bytes of text to the end of that line, compared for reuse
+    bool toEnd;               // the line ends at the end of the input, not with '\n'
+    unsigned long long hash;  // textHash of the size bytes
+    shared_ptr<const void> value;                // copy of the member, or
+    shared_ptr<const CfgCachedEntries> nested;   // entries of the nested struct, or
+    string text;                                 // text of the value, to the end of the line
+    Entry() : keyEntry(NULL), valueSize(0), size(0), toEnd(false), hash(0) {}
+  };
+  vector<Entry> entries;
+  bool complete;  // false if an entry failed to parse, then it isn't cached
+
+  CfgCachedEntries() : complete(true) {}
+
+  /// entry named key, or NULL.  Entries are usually in the same order as
+  ///   before, so entries[next] is tried first
+  const Entry* find(const string& key, size_t& next) const {
+    size_t i = next<entries.size() && entries[next].key==key ? next : 0;
+    for(; i<entries.size() && entries[i].key!=key; i++);
+    if(i==entries.size()) return NULL;
+    next = i+1;
+    return &entries[i];
+  }
+
+  /// true if the text of entry, at start, is unchanged
+  static bool sameText(const Entry& entry, const char* start, const char* end){
+    size_t remaining = end-start;
+    if(remaining<entry.size || (entry.toEnd && remaining!=entry.size)) return false;
+    return textHash(start, start+entry.size)==entry.hash;
+  }
+};
+
+// Process-wide cache of what each struct type parsed from the files read by
+// readFile, see setIncludeCache.  A file's contents aren't kept, only their
+// hash, and for each struct type (identified by its key table) the entries
+// it parsed.  When a file changes, the entries parsed from the previous
+// contents are kept until each struct type has read it again, so entries
+// whose text didn't change are reused.
+class IncludeCache{
+public:
+  static IncludeCache& instance(){
+    static IncludeCache cache;
+    return cache;
+  }
+
+  /// Looks up filename for the struct type with key table type.  If the file
+  ///   is unchanged since that type parsed it, sets entries and leaves file
+  ///   NULL.  Otherwise maps the file into file, and sets entries to those
+  ///   parsed from its previous contents, if any, and hash to the hash of
+  ///   its contents.  Returns false if the file can't be read
+  bool lookup(const string& filename, const void* type, shared_ptr<MappedFile>& file,
+      shared_ptr<const CfgCachedEntries>& entries, unsigned long long& hash){
+    struct stat st;
+    if(stat(filename.c_str(), &st)!=0) return false;
+    time_t now = time(NULL);
+    {
+      lock_guard<mutex> lock(mMutex);
+      map<string,File>::iterator found = mFiles.find(filename);
+      // modification times may only have a resolution of seconds, so they only
+      //   show changes made after the file was cached
+      if(found!=mFiles.end() && found->second.mtime==st.st_mtime && found->second.size==st.st_size &&
+         st.st_mtime+MTIME_RESOLUTION<found->second.cachedAt){
+        found->second.lastUsed = ++mTick;
+        if(findEntries(found->second.parsed, type, entries)) return true;
+      }
+    }
+
+    // read the file, the entries are current if its contents didn't change
+    if(gIncludes) file = gIncludes->get(filename);
+    if(!file) file = make_shared<MappedFile>(filename);
+    if(!file->isOpen()) return false;
+    hash = textHash(file->data(), file->data()+file->size());
+
+    lock_guard<mutex> lock(mMutex);
+    map<string,File>::iterator found = mFiles.find(filename);
+    if(found==mFiles.end()) found = mFiles.insert(make_pair(filename, File(hash))).first;
+    else mBytes -= found->second.bytes;
+    File& cached = found->second;
+    if(cached.hash!=hash){
+      cached.hash = hash;
+      cached.previous.swap(cached.parsed);
+      cached.parsed.clear();
+    }
+    cached.mtime = st.st_mtime;
+    cached.size = st.st_size;
+    cached.cachedAt = now;
+    cached.lastUsed = ++mTick;
+    cached.bytes = file->size()<=MAX_BYTES ? file->size() : 0; // larger files aren't kept
+    mBytes += cached.bytes;
+    evict(filename);
+    if(findEntries(cached.parsed, type, entries)) file.reset();
+    else findEntries(cached.previous, type, entries);
+    return true;
+  }
+
+  /// keeps the entries of filename parsed by struct type, if hash is still
+  ///   the hash of its contents
+  void store(const string& filename, const void* type, unsigned long long hash,
+      const shared_ptr<const CfgCachedEntries>& entries){
+    lock_guard<mutex> lock(mMutex);
+    map<string,File>::iterator found = mFiles.find(filename);
+    if(found==mFiles.end() || found->second.hash!=hash || !found->second.bytes) return;
+    found->second.parsed[type] = entries;
+    found->second.previous.erase(type);
+  }
+
+  void hit()  { mHits++; }
+  void miss() { mMisses++; }
+
+  void stats(unsigned long long& hits, unsigned long long& misses){
+    hits = mHits;
+    misses = mMisses;
+  }
+
+  void clear(){
+    lock_guard<mutex> lock(mMutex);
+    mFiles.clear();
+    mBytes = 0;
+    mHits = mMisses = 0;
+  }
+
+  atomic<bool> enabled;
+
+private:
+  IncludeCache() : enabled(false), mBytes(0), mTick(0), mHits(0), mMisses(0) {}
+
+  typedef map< const void*, shared_ptr<const CfgCachedEntries> > ParsedByType;
+
+  struct File{
+    File(unsigned long long hash) : hash(hash), mtime(0), size(0), cachedAt(0), lastUsed(0), bytes(0) {}
+    unsigned long long hash;  // textHash of the contents
+    time_t mtime;
+    off_t size;
+    time_t cachedAt;
+    unsigned long long lastUsed;  // mTick when last read
+    size_t bytes;                 // counted against MAX_BYTES
+    ParsedByType parsed;    // entries parsed by each struct type, by key table
+    ParsedByType previous;  // entries parsed from the previous contents
+  };
+
+  /// seconds a modification time may be behind the actual modification
+  static const int MTIME_RESOLUTION = 2;
+  /// total size of the cached files, beyond which the least recently read are dropped
+  static const size_t MAX_BYTES = 64<<20;
+
+  static bool findEntries(const ParsedByType& parsed, const void* type, shared_ptr<const CfgCachedEntries>& entries){
+    ParsedByType::const_iterator i = parsed.find(type);
+    entries = i==parsed.end() ? shared_ptr<const CfgCachedEntries>() : i->second;
+    return (bool)entries;
+  }
+
+  /// drops the least recently read files other than keep, until the cache
+  ///   fits in MAX_BYTES.  Called with mMutex held
+  void evict(const string& keep){
+    while(mBytes>MAX_BYTES){
+      map<string,File>::iterator oldest = mFiles.end();
+      for(map<string,File>::iterator i=mFiles.begin(); i!=mFiles.end(); ++i)
+        if(i->first!=keep && (oldest==mFiles.end() || i->second.lastUsed<oldest->second.lastUsed)) oldest = i;
+      if(oldest==mFiles.end()) return;
+      mBytes -= oldest->second.bytes;
+      mFiles.erase(oldest);
+    }
+  }
+
+  mutex mMutex;  // guards all members but the counters
+  map<string,File> mFiles;
+  size_t mBytes;               // sum of the bytes of mFiles
+  unsigned long long mTick;    // incremented on each read of a file
+  atomic<unsigned long long> mHits, mMisses;
+};
+
+void Configurator::setIncludeCache(bool enable){
+  IncludeCache::instance().enabled = enable;
+}
+
+void Configurator::getIncludeCacheStats(unsigned long long& hits, unsigned long long& misses){
+  IncludeCache::instance().stats(hits, misses);
+}
+
+void Configurator::clearIncludeCache(){
+  IncludeCache::instance().clear();
+}
+
+// threads for parsing, see setParseThreads
+static atomic<unsigned> gParseThreads(1);
+// set on threads parsing elements in parallel, so included files are parsed serially
+static thread_local bool gParseWorker = false;
+
+void Configurator::setParseThreads(unsigned threads){
+  gParseThreads = threads;
+}
+
+unsigned Configurator::getParseThreads(){
+  return gParseThreads;
+}
+
+void Configurator::readFile(const string& filename, vector<string>& filesRead){
+  TrackFilesRead track(&filesRead);
+  filesRead.clear();
+  readFile(filename);
+}
+
 void Configurator::readFile(const string& filename){
-  // open file as stream and parse
-  ifstream ifs(filename.c_str());
-  if(!ifs){
+  if(gFilesRead) gFilesRead->push_back(filename);
+  if(IncludeCache::instance().enabled){
+    cfgReadCachedFile(filename);
+    return;
+  }
+  shared_ptr<MappedFile> file;
+  if(gIncludes) file = gIncludes->get(filename);
+  // map file into memory and parse directly from it
+  if(!file) file = make_shared<MappedFile>(filename);
+  if(!file->isOpen()){
     throwError("Configurator ("+getStructName()+") error, file not found: "+filename);
+    return;
   }
-  readStream(ifs);
+  readString(file->data(), file->size());
 }
 
-void Configurator::readStream(istream& stream){
-  string key;
+void Configurator::cfgReadCachedFile(const string& filename){
+  IncludeCache& cache = IncludeCache::instance();
+  const void* type = &cfgGetKeyTable(); // one per struct type
+  shared_ptr<MappedFile> file;
+  shared_ptr<const CfgCachedEntries> entries;
+  unsigned long long hash;
+  if(!cache.lookup(filename, type, file, entries, hash)){
+    throwError("Configurator ("+getStructName()+") error, file not found: "+filename);
+    return;
+  }
+  unsigned threads = gParseWorker ? 1 : gParseThreads.load();
+  if(!file){ // unchanged since this struct type parsed it
+    cfgApplyCached(*entries, threads);
+    return;
+  }
+  // parse it, reusing the entries whose text didn't change
+  const char* begin = file->data();
+  const char* end = begin+file->size();
+  PrefetchScope prefetch(begin, end);
+  CfgReader in(begin, end);
+  in.setParseThreads(threads);
+  shared_ptr<CfgCachedEntries> parsed = make_shared<CfgCachedEntries>();
+  cfgReadCachedStruct(in, entries.get(), *parsed);
+  if(parsed->complete) cache.store(filename, type, hash, parsed);
+}
+
+// true if [p,end) may have an include, e.g. in a struct in a vector.  The
+//   included file can change without the text changing
+static bool mayInclude(const char* p, const char* end){
+  static const char word[] = "include";
+  return search(p, end, word, word+sizeof(word)-1)!=end;
+}
+
+void Configurator::cfgReadCachedStruct(CfgReader& in, const CfgCachedEntries* old, CfgCachedEntries& parsed){
+  IncludeCache& cache = IncludeCache::instance();
   //find first non-white space, skipping '{'
-  while(isspace(stream.peek())||stream.peek()=='{') stream.ignore();
-  while(stream.good()){
-    // push to next element, removing comments
-    while(isspace(stream.peek())||stream.peek()=='#') {
-      string dumpStr;
-      if(stream.peek()=='#') getline(stream,dumpStr);
-      else stream.ignore();
-    }
-    if(stream.peek()=='}') { //end of struct, break out
-      stream.ignore();
-      break;
+  while(CfgReader::isSpace(in.peek())||in.peek()=='{') in.ignore();
+  string key;
+  size_t next = 0; // next entry of old
+  while(!in.fail() && cfgReadKey(in, key)){
+    CfgCachedEntries::Entry entry;
+    entry.key = key;
+    entry.keyEntry = key=="include" ? NULL : cfgFindKey(key);
+    const CfgCachedEntries::Entry* prev = old ? old->find(key, next) : NULL;
+    const char* start = in.pos();
+    const char* valueStart = CfgReader::scanNonSpace(start, in.end());
+    Configurator* nested = entry.keyEntry ? entry.keyEntry->accessor->plainStruct(*this) : NULL;
+    if(nested && valueStart<in.end() && *valueStart=='{'){
+      // nested struct, as cfgSet would read it, caching its entries one by one
+      shared_ptr<CfgCachedEntries> nestedEntries = make_shared<CfgCachedEntries>();
+      nested->cfgReadCachedStruct(in, prev ? prev->nested.get() : NULL, *nestedEntries);
+      if(in.fail()) throwError("Configurator ("+getStructName()+") error, parse error after: "+key);
+      if(in.fail() || !nestedEntries->complete) parsed.complete = false;
+      entry.nested = nestedEntries;
+    }else if(prev && prev->value && CfgCachedEntries::sameText(*prev, start, in.end())){
+      entry = *prev;
+      entry.keyEntry->accessor->assignValue(*this, entry.value.get());
+      in.setPos(start+entry.valueSize);
+      cache.hit();
+    }else{
+      cfgSet(key, in);
+      cache.miss();
+      if(in.fail()) parsed.complete = false;
+      // the text is compared to the end of the line, which has any character
+      //   the parse looked at past the value
+      const char* valueEnd = in.pos();
+      const char* lineEnd = (const char*)memchr(valueEnd, '\n', in.end()-valueEnd);
+      entry.toEnd = !lineEnd;
+      lineEnd = lineEnd ? lineEnd+1 : in.end();
+      entry.valueSize = valueEnd-start;
+      entry.size = lineEnd-start;
+      if(entry.keyEntry && !in.fail() && !mayInclude(start, valueEnd))
+        entry.value = entry.keyEntry->accessor->copyValue(*this);
+      if(entry.value) entry.hash = textHash(start, lineEnd);
+      else            entry.text.assign(start, lineEnd);
     }
-    getline(stream,key,'='); //read until '='
-    if(stream) { //found key
-      key=stripSpaces(key);
-      set(key,stream); // set key based on contents of stream
+    parsed.entries.push_back(std::move(entry));
+
+    //go to next non-whitespace
+    in.skipSpaces();
+  }
+}
+
+void Configurator::cfgApplyCached(const CfgCachedEntries& parsed, unsigned threads){
+  IncludeCache& cache = IncludeCache::instance();
+  for(size_t i=0; i<parsed.entries.size(); i++){
+    const CfgCachedEntries::Entry& entry = parsed.entries[i];
+    if(entry.value){
+      entry.keyEntry->accessor->assignValue(*this, entry.value.get());
+      cache.hit();
+    }else if(entry.nested){
+      entry.keyEntry->accessor->plainStruct(*this)->cfgApplyCached(*entry.nested, threads);
+    }else{ // set from its text, as when it was read
+      CfgReader in(entry.text.data(), entry.text.data()+entry.text.size());
+      in.setParseThreads(threads);
+      cfgSet(entry.key, in);
+      cache.miss();
     }
+  }
+}
+
+void Configurator::readStream(istream& stream){
+  CfgIStreamReader in(stream);
+  in.setParseThreads(gParseWorker ? 1 : gParseThreads.load());
+  PrefetchScope prefetch(in.pos(), in.end());
+  cfgReadStruct(in);
+}
+
+void Configurator::cfgReadStruct(CfgReader& in){
+  //find first non-white space, skipping '{'
+  while(CfgReader::isSpace(in.peek())||in.peek()=='{') in.ignore();
+  string key; // reused for each entry, so long keys don't allocate each time
+  while(!in.fail() && cfgReadKey(in, key)){
+    cfgSet(key,in); // set key based on contents of reader
 
     //go to next non-whitespace
-    while(isspace(stream.peek())) stream.ignore();
+    in.skipSpaces();
+  }
+}
+
+bool Configurator::cfgReadKey(CfgReader& in, string& key){
+  // push to next element, removing comments
+  in.skipSpacesAndComments();
+  if(in.peek()=='}') { //end of struct, break out
+    in.ignore();
+    return false;
+  }
+  if(in.eof()) { //end of input, error if nested struct has no closing brace
+    in.setFail();
+    return false;
+  }
+  //read until '='
+  const char* eq = (const char*)memchr(in.pos(), '=', in.end()-in.pos());
+  const char* keyStart = in.pos();
+  const char* keyEnd = eq ? eq : in.end();
+  in.setPos(eq ? eq+1 : keyEnd);
+  stripSpacesInPlace(keyStart, keyEnd);
+  key.assign(keyStart, keyEnd);
+  return true;
+}
+
+void Configurator::cfgReadElements(CfgReader& in, const string& path,
+    const function<void(CfgReader&)>& element){
+  while(CfgReader::isSpace(in.peek())||in.peek()=='{') in.ignore();
+  string key;
+  while(!in.fail() && cfgReadKey(in, key)){
+    if(key==path){ // the container, each element is passed to element
+      in.skipSpaces();
+      if(in.peek()=='[') in.ignore();
+      else in.setFail();
+      while(!in.fail()){
+        in.skipSeparators();
+        if(in.peek()==']') { in.ignore(); break; }
+        if(in.eof()) { in.setFail(); break; }
+        const char* elementStart = in.pos();
+        element(in);
+        if(in.pos()==elementStart) in.setFail(); // nothing parsed, e.g. stray '}'
+      }
+      if(in.fail()) throwError("Configurator ("+getStructName()+") error, parse error in elements of: "+path);
+    }else if(path.compare(0, key.size()+1, key+".")==0){ // the struct the container is in
+      const CfgKeyEntry* entry = cfgFindKey(key);
+      Configurator* nested = entry ? entry->accessor->nested(*this) : NULL;
+      in.skipSpaces();
+      if(nested && in.peek()=='{') {
+        nested->cfgReadElements(in, path.substr(key.size()+1), element);
+        if(in.fail()) throwError("Configurator ("+getStructName()+") error, parse error after: "+key);
+      }
+      else cfgSet(key,in);
+    }else cfgSet(key,in);
+
+    in.skipSpaces();
+  }
+}
+
+void Configurator::cfgReadFileElements(const string& filename, const string& path,
+    const function<void(CfgReader&)>& element){
+  MappedFile file(filename);
+  if(!file.isOpen()){
+    throwError("Configurator ("+getStructName()+") error, file not found: "+filename);
+    return;
+  }
+  CfgReader in(file.data(), file.data()+file.size());
+  cfgReadElements(in, path, element);
+}
+
+void Configurator::readFileEvents(const string& filename, CfgEventHandler& handler){
+  MappedFile file(filename);
+  if(!file.isOpen()) throw runtime_error("Configurator error, file not found: "+filename);
+  CfgReader in(file.data(), file.data()+file.size());
+  cfgStructEvents(in, handler);
+  // like readFile, the top level struct ends at the end of input
+  if(in.fail() && !in.eof()) throw runtime_error("Configurator error, parse error in: "+filename);
+}
+
+void Configurator::readStringEvents(const string& str, CfgEventHandler& handler){
+  CfgReader in(str.data(), str.data()+str.size());
+  cfgStructEvents(in, handler);
+  if(in.fail() && !in.eof()) throw runtime_error("Configurator error, parse error in string");
+}
+
+void Configurator::cfgStructEvents(CfgReader& in, CfgEventHandler& handler){
+  while(CfgReader::isSpace(in.peek())||in.peek()=='{') in.ignore();
+  string key;
+  while(!in.fail() && cfgReadKey(in, key)){
+    handler.key(key);
+    cfgValueEvents(in, handler);
+    in.skipSpaces();
+  }
+}
+
+void Configurator::cfgValueEvents(CfgReader& in, CfgEventHandler& handler, bool inList){
+  in.skipSpaces();
+  if(in.peek()=='{'){
+    handler.beginStruct();
+    cfgStructEvents(in, handler);
+    if(in.fail()) throw runtime_error("Configurator error, struct has no closing brace");
+    handler.endStruct();
+  }else if(in.peek()=='['){
+    in.ignore();
+    handler.beginList();
+    while(true){
+      in.skipSeparators();
+      if(in.peek()==']') { in.ignore(); break; }
+      if(in.eof() || in.peek()=='}') throw runtime_error("Configurator error, list has no closing bracket");
+      cfgValueEvents(in, handler, true);
+    }
+    handler.endList();
+  }else if(inList){
+    // like elements of a container, values in a list also end at whitespace
+    string text;
+    const char* p = in.pos();
+    const char* end = in.end();
+    for(; p<end && !CfgReader::isSpace(*p) && !isStrDelim(*p); p++){
+      //if '\' followed by delimiter or space, force grab, otherwise keep '\'
+      if(*p=='\\' && p+1<end && (CfgReader::isSpace(p[1]) || isStrDelim(p[1]))) p++;
+      text += *p;
+    }
+    in.setPos(p);
+    if(text == "''" || text == "\"\"") text.clear();
+    handler.value(text);
+  }else{
+    string text;
+    cfgSetFromStream(in, text);
+    handler.value(text);
   }
 }
 
@@ -101,14 +1728,15 @@ std::istream& operator>>(std::istream& is, Configurator& cfg){
 }
 
 void Configurator::readString(const string& str){
-  readString(str.c_str(), str.size());
+  readString(str.data(), str.size());
 }
 
 void Configurator::readString(const char* str, size_t size){
-  // use str as custom buffer in istream without copying
-  StreambufWrapper sb((char*)str, size);  
-  istream is(&sb);                        
-  readStream(is);
+  // parse directly from str without copying
+  CfgReader in(str, str+size);
+  in.setParseThreads(gParseWorker ? 1 : gParseThreads.load());
+  PrefetchScope prefetch(str, str+size);
+  cfgReadStruct(in);
 }
 
 void Configurator::readString(const char* str){
@@ -122,10 +1750,19 @@ void Configurator::writeToFile(const std::string& filename){
 }
 
 void Configurator::writeToStream(ostream& os,int indent){
-  // write struct to stream
-  if(indent>0) os<<"{\n"; //print braces on nested structs only
-  cfgMultiFunction(CFG_WRITE_ALL, NULL, NULL, NULL, &os, indent, NULL); 
-  if(indent>0) os<<Configurator::cfgIndentBy(indent-1)<<"}";
+  // write struct to stream, in large chunks through a CfgWriter
+  CfgWriter out(&os);
+  cfgWriteStruct(out,indent);
+  if(!out.flush()) throwError("Configurator ("+getStructName()+") error, can't write to stream");
+}
+
+void Configurator::cfgWriteStruct(CfgWriter& out, int indent){
+  if(indent>0) out.write("{\n"); //print braces on nested structs only
+  cfgWriteEntries(out,indent);
+  if(indent>0) {
+    out.writeIndent(indent-1);
+    out.put('}');
+  }
 }
 
 std::ostream& operator<<(std::ostream& os, Configurator& cfg) {
@@ -134,9 +1771,10 @@ std::ostream& operator<<(std::ostream& os, Configurator& cfg) {
 }
 
 void Configurator::writeToString(string& str){
-  stringstream ss;
-  writeToStream(ss);
-  str = ss.str();
+  // write directly into the writer's buffer, then take it over
+  CfgWriter out;
+  cfgWriteStruct(out,0);
+  str.swap(out.buffer());
 }
 
 size_t Configurator::writeToString(char* str, size_t maxSize){
@@ -155,6 +1793,209 @@ string Configurator::toString(){
   return str;
 }
 
+void Configurator::writeToBinary(string& buffer){
+  // write into the caller's buffer, reusing its capacity
+  CfgWriter out;
+  out.buffer().swap(buffer);
+  out.buffer().clear();
+  cfgWriteBinaryEntries(out);
+  buffer.swap(out.buffer());
+}
+
+void Configurator::readBinary(const string& buffer){
+  readBinary(buffer.data(), buffer.size());
+}
+
+void Configurator::readBinary(const char* data, size_t size){
+  CfgReader in(data, data+size);
+  cfgReadBinaryEntries(in);
+  if(!in.fail() && !in.eof())
+    throwError("Configurator ("+getStructName()+") error, unexpected data after end of binary");
+}
+
+// header of tagged binary and binary delta: magic, format version, struct name (size then chars)
+// tagged binary:
+//   header "CFGT", schema hash (8 bytes)
+//   struct: size, then for each entry: field id (4 bytes), size, value
+// binary delta:
+//   header "CFGD"
+//   for each changed entry: name ("a.b.c", size then chars), size, value
+static const char TAGGED_MAGIC[4] = { 'C','F','G','T' };
+static const char DELTA_MAGIC[4] = { 'C','F','G','D' };
+static const char BINARY_VERSION = 1;
+
+static void writeBinaryHeader(CfgWriter& out, const char* magic, const string& structName){
+  out.write(magic, 4);
+  out.put(BINARY_VERSION);
+  out.writeVarint(structName.size());
+  out.write(structName);
+}
+
+// returns false if the header doesn't match magic
+static bool readBinaryHeader(CfgReader& in, const char* magic, string& structName){
+  char buf[5];
+  if(!in.read(buf, sizeof(buf)) || memcmp(buf, magic, 4)!=0 || buf[4]!=BINARY_VERSION)
+    return false;
+  unsigned long long size;
+  if(!in.readVarint(size) || size>in.remaining()) return false;
+  structName.assign(in.pos(), (size_t)size);
+  in.setPos(in.pos()+size);
+  return true;
+}
+
+void Configurator::writeToTaggedBinary(string& buffer){
+  // write into the caller's buffer, reusing its capacity
+  CfgWriter out;
+  out.buffer().swap(buffer);
+  out.buffer().clear();
+  out.setTagged(true);
+  writeBinaryHeader(out, TAGGED_MAGIC, getStructName());
+  unsigned long long hash = getSchemaHash();
+  out.write((const char*)&hash, sizeof(hash));
+  cfgWriteTaggedStruct(out);
+  buffer.swap(out.buffer());
+}
+
+bool Configurator::readTaggedBinary(const string& buffer){
+  return readTaggedBinary(buffer.data(), buffer.size());
+}
+
+// reads header of tagged binary, leaves reader at the struct
+static bool readTaggedHeader(CfgReader& in, string& structName, unsigned long long& schemaHash){
+  return readBinaryHeader(in, TAGGED_MAGIC, structName) && in.read(&schemaHash, sizeof(schemaHash));
+}
+
+bool Configurator::readTaggedBinaryHeader(const char* data, size_t size,
+  string& structName, unsigned long long& schemaHash){
+  CfgReader in(data, data+size);
+  return readTaggedHeader(in, structName, schemaHash);
+}
+
+bool Configurator::readTaggedBinary(const char* data, size_t size){
+  CfgReader in(data, data+size);
+  in.setTagged(true);
+  string name;
+  unsigned long long hash = 0;
+  if(!readTaggedHeader(in, name, hash))
+    throwError("Configurator ("+getStructName()+") error, not tagged binary data");
+  if(name!=getStructName())
+    throwError("Configurator ("+getStructName()+") error, tagged binary data is for struct: "+name);
+  cfgReadTaggedStruct(in);
+  if(in.fail())
+    throwError("Configurator ("+getStructName()+") error, tagged binary data is truncated");
+  if(!in.eof())
+    throwError("Configurator ("+getStructName()+") error, unexpected data after end of binary");
+  return hash==getSchemaHash();
+}
+
+void Configurator::cfgWriteTaggedStruct(CfgWriter& out){
+  const CfgKeyTable& table = cfgGetKeyTable();
+  const vector<CfgKeyEntry>& entries = table.entries;
+  size_t start = out.beginSized();
+  if(!table.idCollision.empty()) { // written as an empty struct if throwError returns
+    throwError("Configurator ("+getStructName()+") error, keys with the same field id, rename one for tagged binary: "+
+      table.idCollision);
+    out.endSized(start);
+    return;
+  }
+  for(size_t i=0; i<entries.size(); i++){
+    const CfgKeyEntry& entry = entries[i];
+    out.write((const char*)&entry.id, sizeof(entry.id));
+    size_t valStart = out.beginSized();
+    entry.accessor->writeBinary(*this, out);
+    out.endSized(valStart);
+  }
+  out.endSized(start);
+}
+
+void Configurator::cfgReadTaggedStruct(CfgReader& in){
+  unsigned long long size;
+  if(!in.readVarint(size)) return;
+  if(size>in.remaining()) { in.setFail(); return; }
+  const char* end = in.pos()+size;
+
+  const CfgKeyTable& table = cfgGetKeyTable();
+  if(!table.idCollision.empty()) {
+    throwError("Configurator ("+getStructName()+") error, keys with the same field id, rename one for tagged binary: "+
+      table.idCollision);
+    in.setFail();
+    return;
+  }
+
+  // entries missing from the data keep their defaults
+  cfgMultiFunction(CFG_INIT_ALL,NULL,NULL,NULL,NULL,0,NULL);
+
+  size_t next = 0; // entries are usually in declaration order, try the next one first
+  CfgReader field;
+  field.setTagged(true);
+  while(in.pos()<end){
+    unsigned id;
+    unsigned long long valSize;
+    if(!in.read(&id, sizeof(id)) || !in.readVarint(valSize)) return;
+    if(valSize>(size_t)(end-in.pos())) { in.setFail(); return; }
+    const char* valEnd = in.pos()+valSize;
+
+    const CfgKeyEntry* entry = NULL;
+    if(next<table.entries.size() && table.entries[next].id==id) {
+      entry = &table.entries[next];
+    } else {
+      CfgKeyEntry key = { NULL, id, 0, nullptr };
+      vector<CfgKeyEntry>::const_iterator it = lower_bound(table.byId.begin(), table.byId.end(), key, cfgLessById);
+      if(it!=table.byId.end() && it->id==id) entry = &table.entries[it->index];
+    }
+
+    if(entry) { // read value from exactly its own bytes
+      field.reset(in.pos(), valEnd);
+      entry->accessor->readBinary(*this, field);
+      if(field.fail() || !field.eof())
+        throwError("Configurator ("+getStructName()+") error, can't read binary variable: "+entry->name);
+      next = entry->index+1;
+    }
+    in.setPos(valEnd); // unknown entries are skipped
+  }
+  if(in.pos()!=end) in.setFail();
+}
+
+unsigned Configurator::cfgFieldId(const char* name){
+  unsigned hash = 2166136261u;
+  for(; *name; name++) hash = (hash ^ (unsigned char)*name) * 16777619u;
+  return hash;
+}
+
+void Configurator::cfgWriteSchema(string& schema, vector<string>& stack){
+  string name = getStructName();
+  schema += name;
+  if(find(stack.begin(), stack.end(), name)!=stack.end()) return; // recursive struct
+  stack.push_back(name);
+  schema += '{';
+  const vector<CfgKeyEntry>& entries = cfgGetKeyTable().entries;
+  for(size_t i=0; i<entries.size(); i++){
+    schema += entries[i].name;
+    schema += ':';
+    entries[i].accessor->writeSchema(schema, stack);
+    schema += ';';
+  }
+  schema += '}';
+  stack.pop_back();
+}
+
+unsigned long long Configurator::getSchemaHash(){
+  // computed once per struct type, outside of building the key table,
+  //   since describing a struct builds the key tables of nested structs
+  static mutex schemaMutex;
+  lock_guard<mutex> lock(schemaMutex);
+  const CfgKeyTable& table = cfgGetKeyTable();
+  if(!table.schemaHash){
+    string schema;
+    vector<string> stack;
+    cfgWriteSchema(schema, stack);
+    unsigned long long hash = 14695981039346656037ULL; // FNV-1a 64 bit
+    for(size_t i=0; i<schema.size(); i++) hash = (hash ^ (unsigned char)schema[i]) * 1099511628211ULL;
+    table.schemaHash = hash ? hash : 1;
+  }
+  return table.schemaHash;
+}
+
 bool Configurator::operator==(Configurator& other){
   return !cfgCompareHelper(*this, other); // cfgCompareHelper return 0 if same
 }
@@ -163,121 +2004,424 @@ bool Configurator::operator!=(Configurator& other){
   return cfgCompareHelper(*this, other); // cfgCompareHelper return 0 if same
 }
 
+size_t Configurator::hash(){
+  return cfgHashEntries();
+}
+
+vector<string> Configurator::diff(Configurator& other){
+  // collects the names of the changed entries
+  class Handler : public CfgDiffHandler{
+  public:
+    vector<string> paths;
+    void changed(const string& path, Configurator& cfg, const CfgKeyEntry& entry){
+      paths.push_back(path);
+    }
+  } handler;
+  if(typeid(*this)!=typeid(other))
+    throwError("Configurator ("+getStructName()+") error, can't diff with struct of different type: "+other.getStructName());
+  else cfgDiff(other, "", handler);
+  return handler.paths;
+}
+
+void Configurator::writeDelta(Configurator& baseline, ostream& stream){
+  // writes "a.b.c=value" for each changed entry
+  class Handler : public CfgDiffHandler{
+  public:
+    Handler(Configurator& self, CfgWriter& out) : self(self), out(out) {}
+    void changed(const string& path, Configurator& cfg, const CfgKeyEntry& entry){
+      if(!entry.accessor->isSet(cfg)) {
+        self.throwError("Configurator ("+self.getStructName()+") error, can't write unset Optional to text delta: "+path);
+        return;
+      }
+      out.write(path);
+      out.put('=');
+      entry.accessor->writeText(cfg, out, 0);
+      out.put('\n');
+      out.flushIfFull();
+    }
+  private:
+    Configurator& self;
+    CfgWriter& out;
+  };
+  if(typeid(*this)!=typeid(baseline)) {
+    throwError("Configurator ("+getStructName()+") error, can't write delta to struct of different type: "+baseline.getStructName());
+    return;
+  }
+  CfgWriter out(&stream);
+  Handler handler(*this, out);
+  cfgDiff(baseline, "", handler);
+  if(!out.flush()) throwError("Configurator ("+getStructName()+") error, can't write to stream");
+}
+
+void Configurator::writeBinaryDelta(Configurator& baseline, string& buffer){
+  // writes name, size and value of each changed entry
+  class Handler : public CfgDiffHandler{
+  public:
+    Handler(CfgWriter& out) : out(out) {}
+    void changed(const string& path, Configurator& cfg, const CfgKeyEntry& entry){
+      out.writeVarint(path.size());
+      out.write(path);
+      size_t start = out.beginSized();
+      entry.accessor->writeBinary(cfg, out);
+      out.endSized(start);
+    }
+  private:
+    CfgWriter& out;
+  };
+  if(typeid(*this)!=typeid(baseline)) {
+    throwError("Configurator ("+getStructName()+") error, can't write delta to struct of different type: "+baseline.getStructName());
+    return;
+  }
+  // write into the caller's buffer, reusing its capacity
+  CfgWriter out;
+  out.buffer().swap(buffer);
+  out.buffer().clear();
+  out.setTagged(true);
+  writeBinaryHeader(out, DELTA_MAGIC, getStructName());
+  Handler handler(out);
+  cfgDiff(baseline, "", handler);
+  buffer.swap(out.buffer());
+}
+
+void Configurator::readBinaryDelta(const string& buffer){
+  readBinaryDelta(buffer.data(), buffer.size());
+}
+
+void Configurator::readBinaryDelta(const char* data, size_t size){
+  CfgReader in(data, data+size);
+  string name;
+  if(!readBinaryHeader(in, DELTA_MAGIC, name)) {
+    throwError("Configurator ("+getStructName()+") error, not binary delta data");
+    return;
+  }
+  if(name!=getStructName()) {
+    throwError("Configurator ("+getStructName()+") error, binary delta is for struct: "+name);
+    return;
+  }
+  CfgReader field;
+  field.setTagged(true);
+  string path;
+  while(!in.eof()){
+    unsigned long long valSize;
+    cfgReadBinaryHelper(in, path);
+    if(in.fail()) { // path runs past the end, don't use what it holds
+      throwError("Configurator ("+getStructName()+") error, binary delta is truncated");
+      return;
+    }
+    if(!in.readVarint(valSize) || valSize>in.remaining()) break;
+    Configurator* owner;
+    const CfgKeyEntry* entry = cfgFindEntry(path, owner);
+    if(!entry) { // throwError didn't throw, skip the record
+      in.setPos(in.pos()+valSize);
+      continue;
+    }
+    // read value from exactly its own bytes
+    field.reset(in.pos(), in.pos()+valSize);
+    entry->accessor->readBinary(*owner, field);
+    if(field.fail() || !field.eof())
+      throwError("Configurator ("+getStructName()+") error, can't read binary variable: "+path);
+    in.setPos(in.pos()+valSize);
+  }
+  if(!in.eof())
+    throwError("Configurator ("+getStructName()+") error, binary delta is truncated");
+}
+
+void Configurator::cfgDiff(Configurator& other, const string& prefix, CfgDiffHandler& handler){
+  const vector<CfgKeyEntry>& entries = cfgGetKeyTable().entries;
+  for(size_t i=0; i<entries.size(); i++){
+    const CfgKeyEntry& entry = entries[i];
+    Configurator* nested = entry.accessor->nested(*this);
+    if(nested) nested->cfgDiff(*entry.accessor->nested(other), prefix+entry.name+'.', handler);
+    else if(entry.accessor->compare(*this, other)) handler.changed(prefix+entry.name, *this, entry);
+  }
+}
+
+const Configurator::CfgKeyEntry* Configurator::cfgFindKey(const string& name){
+  return cfgFindKey(name.data(), name.size());
+}
+
+const Configurator::CfgKeyEntry* Configurator::cfgFindKey(const char* name, size_t size){
+  // name isn't null terminated, an entry whose name starts with it isn't less
+  const vector<CfgKeyEntry>& table = cfgGetKeyTable().byName;
+  vector<CfgKeyEntry>::const_iterator it = lower_bound(table.begin(), table.end(), name,
+    [size](const CfgKeyEntry& entry, const char* name){ return strncmp(entry.name, name, size)<0; });
+  if(it==table.end() || strncmp(it->name, name, size)!=0 || it->name[size]!=0) return NULL;
+  return &*it;
+}
+
+const Configurator::CfgKeyEntry* Configurator::cfgFindEntry(const string& path, Configurator*& owner){
+  owner = this;
+  size_t start = 0;
+  while(true){
+    size_t dot = path.find('.', start);
+    string name = path.substr(start, dot==string::npos ? string::npos : dot-start);
+    const CfgKeyEntry* entry = owner->cfgFindKey(name);
+    if(dot==string::npos && entry) return entry;
+    owner = entry ? entry->accessor->nested(*owner) : NULL;
+    if(!owner) {
+      throwError("Configurator ("+getStructName()+") error, key not recognized: "+path);
+      return NULL;
+    }
+    start = dot+1;
+  }
+}
+
 void Configurator::set(const std::string& varName, const std::string& val){
   // set varname = val
-  stringstream ss(val);
-  set(varName,ss);
+  CfgReader in(val.data(), val.data()+val.size());
+  cfgSet(varName,in);
 }
 
 void Configurator::set(const std::string& varName, std::istream& stream){
+  CfgIStreamReader in(stream);
+  cfgSet(varName,in);
+}
+
+void Configurator::cfgSet(const std::string& varName, CfgReader& in){
   if(varName=="include"){ // e.g. "include = filename"
     string filename;
-    cfgSetFromStream(stream,filename); //get filename
+    cfgSetFromStream(in,filename); //get filename
     readFile(filename);  //parse contents of file (recurse)
-  }else{ // set varName from contents of stream
+  }else{ // set varName from contents of reader
     // Check for '.' separated format, e.g. "a.b.c=1"
     // If so, strip off baseVar (a) from subVar (b.c)
+    // Both are usually short, and found without copying varName
     size_t pos=varName.find_first_of('.');
-    string baseVar = stripSpaces(varName.substr(0,pos));  //first var: e.g. "a"
-    string subVar;
-    if(pos!=string::npos) subVar = varName.substr(pos+1); //subsequent vars: e.g. "b.c"
+    const char* baseStart = varName.data(); //first var: e.g. "a"
+    const char* baseEnd = pos==string::npos ? baseStart+varName.size() : baseStart+pos;
+    stripSpacesInPlace(baseStart, baseEnd);
+    static const string noSubVar;
+    string subVarCopy;
+    if(pos!=string::npos) subVarCopy = varName.substr(pos+1); //subsequent vars: e.g. "b.c"
+    const string& subVar = pos==string::npos ? noSubVar : subVarCopy;
 
-    // set value of variable by parsing stream
-    int rc=cfgMultiFunction(CFG_SET,&baseVar,&subVar,&stream,NULL,0,NULL);
-    if(rc==0) throwError("Configurator ("+getStructName()+") error, key not recognized: "+varName);
-    if(rc>1) throwError("Configurator ("+getStructName()+") error, multiple keys with the same name not allowed: "+varName);
-    if(!stream) throwError("Configurator ("+getStructName()+") error, parse error after: "+varName);
+    // look up variable in key table
+    const CfgKeyEntry* entry = cfgFindKey(baseStart, baseEnd-baseStart);
+    if(!entry) {
+      throwError("Configurator ("+getStructName()+") error, key not recognized: "+varName);
+      return;
+    }
+
+    // set value of variable by parsing reader
+    entry->accessor->set(*this,in,subVar);
+    if(in.fail()) throwError("Configurator ("+getStructName()+") error, parse error after: "+varName);
   }
 }
 
-std::string Configurator::cfgIndentBy(int i){
-  // return i*2 spaces, for printing
-  std::string str;
-  for(int j=0;j<i;j++) str+="  ";
-  return str;
+size_t Configurator::cfgCountItems(const char* p, const char* end){
+  // chars that change the count or the depth
+  static const struct ItemChars{
+    bool is[256];
+    ItemChars() : is() { for(const char* c=",[]{}\\#"; *c; c++) is[(unsigned char)*c] = true; }
+  } chars;
+  size_t commas = 0;
+  int depth = 0;
+  const char* first = p;
+  for(; p<end; p++){
+    if(!chars.is[(unsigned char)*p]) continue;
+    char c = *p;
+    if(c==',') { if(depth==0) commas++; }
+    else if(c=='[' || c=='{') depth++;
+    else if(c==']' || c=='}') { if(--depth<0) break; }
+    else if(c=='\\') { if(p+1<end) p++; }
+    else { // comment
+      p = (const char*)memchr(p, '\n', end-p);
+      if(!p) { p = end; break; }
+    }
+  }
+  // empty container, or an item after each comma
+  if(CfgReader::scanNonSeparator(first, p)==p) return 0;
+  return commas+1;
 }
 
-static char readuntil(istream& stream, string& str, const string& delimit){
-  // similar to readline, but with multiple delimiters
-  char c;
-  str="";
-  while(stream.get(c)){
-    if(delimit.find(c)!=string::npos) break; //found delimit
-    if(c=='\\') { //check for escape character
-      char cNext = stream.peek(); //peek at next char
-      //if delimiter, force grab, otherwise keep '\'
-      if(delimit.find(cNext)!=string::npos) stream.get(c); 
+bool Configurator::cfgScanElements(CfgReader& in, vector< pair<const char*,const char*> >& elements,
+    const char*& end){
+  CfgReader scan(CfgReader::scanNonSpace(in.pos(), in.end()), in.end());
+  if(scan.peek()!='[') return false;
+  scan.ignore();
+  while(true){
+    scan.skipSeparators();
+    if(scan.eof()) return false;
+    if(scan.peek()==']') { end = scan.pos()+1; return true; }
+    if(scan.peek()!='{' && scan.peek()!='[') return false; // other elements are parsed serially
+
+    const char* start = scan.pos();
+    const char* p = cfgMatchBracket(start, scan.end());
+    if(!p) return false; // no closing bracket, let the serial parse report it
+    elements.push_back(make_pair(start, p));
+    scan.setPos(p);
+  }
+}
+
+const char* Configurator::cfgMatchBracket(const char* p, const char* e){
+  if(p>=e || (*p!='{' && *p!='[')) return NULL;
+  int depth = 0;
+  for(; p<e; p++){
+    char c = *p;
+    if(c=='{' || c=='[') depth++;
+    else if(c=='}' || c==']') { if(--depth==0) return p+1; }
+    else if(c=='\\') { if(p+1<e) p++; }
+    else if(c=='#') {
+      p = (const char*)memchr(p, '\n', e-p);
+      if(!p) return NULL;
+    }
+  }
+  return NULL;
+}
+
+bool Configurator::cfgParseElements(CfgReader& in, const vector< pair<const char*,const char*> >& elements,
+    const function<void(size_t, CfgReader&)>& parse){
+  size_t threads = in.parseThreads() ? in.parseThreads() : thread::hardware_concurrency();
+  threads = min(threads, elements.size()/PARALLEL_MIN_ELEMENTS);
+  if(threads<2) return false;
+
+  // files read by includes in each element, added to gFilesRead in element order
+  vector<string>* parentFilesRead = gFilesRead;
+  IncludePrefetcher* parentIncludes = gIncludes;
+  vector< vector<string> > filesRead(parentFilesRead ? elements.size() : 0);
+
+  static const size_t BATCH = 16;  // elements taken by a thread at a time
+  atomic<size_t> next(0);
+  atomic<bool> failed(false);
+  auto worker = [&]{
+    bool prevWorker = gParseWorker;
+    IncludePrefetcher* prevIncludes = gIncludes;
+    gParseWorker = true;
+    gIncludes = parentIncludes;
+    while(!failed){
+      size_t first = next.fetch_add(BATCH);
+      if(first>=elements.size()) break;
+      for(size_t i=first; i<min(first+BATCH, elements.size()) && !failed; i++){
+        CfgReader element(elements[i].first, elements[i].second);
+        TrackFilesRead track(parentFilesRead ? &filesRead[i] : NULL);
+        try{
+          parse(i, element);
+          if(element.fail() || !element.eof()) failed = true;
+        }catch(...){
+          failed = true;
+        }
+      }
     }
-    str+=c;
+    gParseWorker = prevWorker;
+    gIncludes = prevIncludes;
+  };
+
+  vector<thread> pool;
+  try{
+    for(size_t t=1; t<threads; t++) pool.push_back(thread(worker));
+  }catch(std::system_error&){
+    // fewer threads than requested, the others take the rest
   }
-  if(stream) return c; //return last delimiter
-  
-  if(str.size()>0) stream.clear(); // read successful, clear fail
-  return 0; //return 0 if end of stream
+  worker();
+  for(size_t t=0; t<pool.size(); t++) pool[t].join();
+  if(failed) return false;
+
+  if(parentFilesRead)
+    for(size_t i=0; i<filesRead.size(); i++)
+      parentFilesRead->insert(parentFilesRead->end(), filesRead[i].begin(), filesRead[i].end());
+  return true;
 }
 
-void Configurator::cfgSetFromStream(istream& ss, string& str, const std::string& subVar){
+void Configurator::cfgSetFromStream(CfgReader& in, string& str, const std::string& subVar){
   // special handing of string (default handling only reads one word)
-  if(!subVar.empty()) { //subVar should be empty
-    ss.setstate(ios::failbit); //set fail bit to trigger error handling
+  if(!subVar.empty() || in.eof()) { //subVar should be empty, and something to read
+    in.setFail(); //set fail to trigger error handling
     return;
   }
-  char c=readuntil(ss,str,STR_DELIM); //find end of string
-  if(c) ss.putback(c); // put the delimiter back on, so it can be handled later
-  str = stripSpaces(str); 
+  // find end of string, the delimiter is left to be handled later
+  const char* start = in.pos();
+  const char* end = in.end();
+  const char* p = CfgReader::scanStrDelim(start,end);
+  if(p==end || *p!='\\') { // no escape characters, copy directly
+    const char* a = start;
+    const char* b = p;
+    stripSpacesInPlace(a,b);
+    str.assign(a,b); // reuses the capacity str already has
+  } else {
+    str.clear();
+    while(p<end && *p=='\\'){
+      str.append(start,p);
+      //if '\' followed by delimiter, force grab, otherwise keep '\'
+      if(p+1<end && isStrDelim(p[1])) p++;
+      start = p++;
+      p = CfgReader::scanStrDelim(p,end);
+    }
+    str.append(start,p);
+    str = stripSpaces(str);
+  }
+  in.setPos(p);
   if(str == "''" || str == "\"\"") str = ""; // "" and '' indicate empty string
 }
 
-void Configurator::cfgSetFromStream(std::istream& ss, Configurator& cfg, const std::string& subVar){
-  // read struct from stream
-  if(!subVar.empty()) cfg.set(subVar,ss);  //handle a.b.c=1 format, recursively
-  else                cfg.readStream(ss);  //handle standard format (a=1)
+void Configurator::cfgSetFromStream(CfgReader& in, Configurator& cfg, const std::string& subVar){
+  // read struct from reader
+  if(!subVar.empty()) cfg.cfgSet(subVar,in);  //handle a.b.c=1 format, recursively
+  else                cfg.cfgReadStruct(in);  //handle standard format (a=1)
 } 
 
-static bool streql(const string&str1, const string&str2){
-  // compare strings case insensitive
+static bool streql(const char* a, const char* b, const char* str2){
+  // compare [a,b) to str2 case insensitive
+  size_t size = strlen(str2);
+  if((size_t)(b-a)!=size) return false;
   #ifdef __GNUC__
-    return strcasecmp(str1.c_str(),str2.c_str())==0;
+    return strncasecmp(a,str2,size)==0;
   #else
-    return _stricmp(str1.c_str(),str2.c_str())==0;
+    return _strnicmp(a,str2,size)==0;
   #endif
 }
 
-void Configurator::cfgSetFromStream(istream& ss, bool& b, const std::string& subVar){
+void Configurator::cfgSetFromStream(CfgReader& in, bool& b, const std::string& subVar){
   if(!subVar.empty()) { //subVar should be empty
-    ss.setstate(ios::failbit); //set fail bit to trigger error handling
+    in.setFail(); //set fail to trigger error handling
     return;
   }
+  // compare the word in place, unless it has escape characters
+  const char* start = in.pos();
+  const char* end = CfgReader::scanStrDelim(start,in.end());
   string str;
-  cfgSetFromStream(ss,str);
-  str=stripSpaces(str);
-  if(streql(str,"true") || streql(str,"t") || streql(str,"1")){
+  if(end<in.end() && *end=='\\'){
+    cfgSetFromStream(in,str);
+    start = str.data();
+    end = start+str.size();
+  }else{
+    if(in.eof()) { in.setFail(); return; } //something to read
+    in.setPos(end);
+    stripSpacesInPlace(start,end);
+  }
+  if(streql(start,end,"true") || streql(start,end,"t") || streql(start,end,"1")){
     b=true;
-  }else if(streql(str,"false") || streql(str,"f") || streql(str,"0")){
+  }else if(streql(start,end,"false") || streql(start,end,"f") || streql(start,end,"0")){
     b=false;
-  }else ss.setstate(ios::failbit); //set fail bit to trigger error handling
+  }else in.setFail(); //set fail to trigger error handling
 }
 
-void Configurator::cfgWriteToStreamHelper(std::ostream& stream, Configurator& cfg, int indent){
-  // write struct to stream
-  cfg.writeToStream(stream,indent+1);
+void Configurator::cfgWriteToStreamHelper(CfgWriter& out, Configurator& cfg, int indent){
+  // write nested struct
+  cfg.cfgWriteStruct(out,indent+1);
 }
 
-void Configurator::cfgWriteToStreamHelper(std::ostream& stream, bool& b, int indent){
-  if(b) stream<<"true";
-  else  stream<<"false";
+void Configurator::cfgWriteToStreamHelper(CfgWriter& out, bool& b, int indent){
+  if(b) out.write("true",4);
+  else  out.write("false",5);
 }
 
-void Configurator::cfgWriteToStreamHelper(std::ostream& stream, std::string& str, int indent){
-  if(str.empty()) stream<<"''";  //empty string indicated by ''
-  else {
-    stringstream tmpSs(str);
-    string tmpStr;
-    while(1){   // write str to stream, prepending delimiters with '\'
-      char c=readuntil(tmpSs,tmpStr,STR_DELIM);
-      stream<<tmpStr;
-      if(c) stream<<"\\"<<c; //prepend delimiter
-      else  break;
+void Configurator::cfgWriteToStreamHelper(CfgWriter& out, std::string& str, int indent){
+  if(str.empty()) out.write("''",2);  //empty string indicated by ''
+  else { // write str, prepending delimiters with '\'
+    const char* p = str.data();
+    const char* end = p+str.size();
+    while(p<end){
+      const char* q = CfgReader::scanStrDelim(p,end);
+      out.write(p,q-p);
+      if(q==end) break;
+      if(*q!='\\') { //prepend delimiter
+        out.put('\\');
+        out.put(*q);
+      } else if(q+1<end && isStrDelim(q[1])) { //'\' followed by delimiter is written as the bare delimiter
+        out.put(q[1]);
+        q++;
+      } else out.put('\\'); //otherwise keep '\'
+      p = q+1;
     }
   }
 }
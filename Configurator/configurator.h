@@ -23,6 +23,10 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <unordered_set>
+#include <unordered_map>
+#include <deque>
+#include <list>
 #include <array>
 #include <sstream>
 #include <fstream>
@@ -30,9 +34,18 @@
 #include <iomanip>
 #include <iterator>
 #include <type_traits>
+#include <limits>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <tuple>
 #include <assert.h>
+#include <string.h>
+#include <stdio.h>
 
 #include "Optional.h"
+#include "SmallVector.h"
+#include "Lazy.h"
 
 #ifdef _MSC_VER // if Visual Studio
 #pragma warning( error : 4002 ) // treat macros with incorrect number of args as error
@@ -40,6 +53,303 @@
 
 namespace codepi {
 
+//////////////////////////////////////////////////////////////////
+// CfgReader - input of the parser
+// Scans a contiguous char range [begin,end) by pointer, without copying.
+// Like an istream, it has a fail flag that is set on parse error.
+
+class CfgReader{
+public:
+  CfgReader(const char* begin=NULL, const char* end=NULL);
+  virtual ~CfgReader();
+
+  /// set range to parse
+  void reset(const char* begin, const char* end){
+    mBegin = mPos = begin;
+    mEnd = end;
+    mFail = false;
+  }
+
+  /// state, similar to istream
+  bool good() const { return !mFail && mPos<mEnd; }
+  bool fail() const { return mFail; }
+  bool eof()  const { return mPos>=mEnd; }
+  void setFail()    { mFail = true; }
+  explicit operator bool() const { return !mFail; }
+
+  /// returns next char without consuming it, or EOF
+  int peek() const { return mPos<mEnd ? (unsigned char)*mPos : EOF; }
+  /// consume one char
+  void ignore() { if(mPos<mEnd) mPos++; }
+
+  /// direct access to the range being parsed
+  const char* begin() const { return mBegin; }
+  const char* pos() const { return mPos; }
+  const char* end() const { return mEnd; }
+  void setPos(const char* pos) { mPos = pos; }
+
+  static bool isSpace(int c) { return c==' '||c=='\t'||c=='\n'||c=='\r'||c=='\v'||c=='\f'; }
+
+  /// Scanners, vectorized with SSE2/AVX2 where the cpu supports it.
+  /// Each returns the first char in [p,end) that matches, or end.
+  /// first non-whitespace char
+  static const char* scanNonSpace(const char* p, const char* end);
+  /// first char that isn't whitespace or ','
+  static const char* scanNonSeparator(const char* p, const char* end);
+  /// first string delimiter (,#}]\t\r\n) or escape character '\'
+  static const char* scanStrDelim(const char* p, const char* end);
+
+  /// skip whitespace
+  void skipSpaces(){
+    if(mPos<mEnd && isSpace(*mPos)) mPos = scanNonSpace(mPos+1, mEnd);
+  }
+
+  /// skip whitespace and comments (# to end of line)
+  void skipSpacesAndComments(){
+    while(mPos<mEnd){
+      if(isSpace(*mPos)) mPos = scanNonSpace(mPos+1, mEnd);
+      else if(*mPos=='#') skipLine();
+      else break;
+    }
+  }
+
+  /// skip whitespace, commas and comments, i.e. push to next element in list
+  void skipSeparators(){
+    while(mPos<mEnd){
+      if(isSpace(*mPos) || *mPos==',') mPos = scanNonSeparator(mPos+1, mEnd);
+      else if(*mPos=='#') skipLine();
+      else break;
+    }
+  }
+
+  /// skip past end of line
+  void skipLine(){
+    const char* eol = (const char*)memchr(mPos, '\n', mEnd-mPos);
+    mPos = eol ? eol+1 : mEnd;
+  }
+
+  /// binary input.  Returns false and sets fail if the input is too short.
+  bool read(void* dst, size_t n){
+    if((size_t)(mEnd-mPos)<n) { mFail = true; return false; }
+    memcpy(dst, mPos, n);
+    mPos += n;
+    return true;
+  }
+  /// unsigned LEB128, as written by CfgWriter::writeVarint
+  bool readVarint(unsigned long long& val){
+    val = 0;
+    for(int shift=0; shift<64 && mPos<mEnd; shift+=7){
+      unsigned char c = (unsigned char)*mPos++;
+      val |= (unsigned long long)(c&0x7F) << shift;
+      if(!(c&0x80)) return true;
+    }
+    mFail = true;
+    return false;
+  }
+  /// bytes left to read
+  size_t remaining() const { return mEnd-mPos; }
+
+  /// binary format flag, like an istream format flag: if set, nested structs
+  ///   are read with field tags (see Configurator::readTaggedBinary)
+  void setTagged(bool tagged) { mTagged = tagged; }
+  bool tagged() const { return mTagged; }
+
+  /// threads for parsing large containers, see Configurator::setParseThreads.
+  ///   1 parses serially, 0 uses one thread per core
+  void setParseThreads(unsigned threads) { mParseThreads = threads; }
+  unsigned parseThreads() const { return mParseThreads; }
+
+  /// locale free number parsing, same formats as operator>> with std::setbase(0),
+  ///   i.e. 0x prefix for hex, 0 prefix for octal.  Floating point also accepts inf and nan.
+  /// skips leading whitespace.  returns false if no valid number or out of range.
+  bool readInteger(unsigned long long& magnitude, bool& negative);
+  bool readNumber(double& val);
+  bool readNumber(float& val);
+
+  /// istream positioned at pos(), for types only parsable with operator>>
+  /// call syncFromStream() when done reading from it
+  std::istream& stream();
+  /// advance pos() to where stream() stopped reading, and copy its fail state
+  void syncFromStream();
+
+private:
+  CfgReader(const CfgReader&);
+  CfgReader& operator=(const CfgReader&);
+
+  class StreamAdapter;
+  const char *mBegin, *mPos, *mEnd;
+  bool mFail;
+  bool mTagged;
+  unsigned mParseThreads;
+  std::unique_ptr<StreamAdapter> mpStream;
+};
+
+/// CfgReader for std::istream. Copies the rest of the stream into a buffer.
+/// On destruction, seeks the stream back to just past what was parsed
+///   (if the stream is seekable), and sets failbit on parse error.
+/// If the stream can't seek, e.g. a pipe, a struct or list in brackets is
+///   only read up to its closing bracket, so "is >> cfgA >> cfgB" works.
+class CfgIStreamReader : public CfgReader{
+public:
+  CfgIStreamReader(std::istream& is);
+  ~CfgIStreamReader();
+private:
+  std::istream& mIs;
+  std::streampos mStart;
+  std::string mBuffer;
+};
+
+//////////////////////////////////////////////////////////////////
+// CfgWriter - output of the writer
+// Appends to a growable buffer, which is written to the sink stream
+//   (if any) in large chunks instead of per line.
+// Like an ostream, it has a fail flag that is set if the sink fails.
+
+class CfgWriter{
+public:
+  /// if sink is NULL, everything is kept in buffer()
+  CfgWriter(std::ostream* sink=NULL);
+  virtual ~CfgWriter();
+
+  /// append to buffer
+  void put(char c) { mBuffer.push_back(c); }
+  void write(const char* s, size_t n) { mBuffer.append(s, n); }
+  void write(const char* s) { mBuffer.append(s); }
+  void write(const std::string& s) { mBuffer.append(s); }
+  /// append i*2 spaces
+  void writeIndent(int i);
+
+  /// locale free number formatting.  Floating point is written with the
+  ///   fewest digits that read back to the same value.
+  void writeInteger(unsigned long long magnitude, bool negative);
+  void writeNumber(double val);
+  void writeNumber(float val);
+
+  /// binary output, unsigned LEB128 (7 bits per byte, low bits first)
+  void writeVarint(unsigned long long val){
+    char buf[10];
+    size_t n = 0;
+    while(val>=0x80) { buf[n++] = char(val|0x80); val >>= 7; }
+    buf[n++] = char(val);
+    mBuffer.append(buf, n);
+  }
+  /// size prefixed binary output: beginSized() reserves the prefix and returns
+  ///   where the data starts, endSized(start) fills in the size of everything
+  ///   written since as a varint.  Only for writers without a sink.
+  size_t beginSized() { mBuffer.push_back(0); return mBuffer.size(); }
+  void endSized(size_t start);
+
+  /// binary format flag, like an ostream format flag: if set, nested structs
+  ///   are written with field tags (see Configurator::writeToTaggedBinary)
+  void setTagged(bool tagged) { mTagged = tagged; }
+  bool tagged() const { return mTagged; }
+
+  /// write buffer to sink once it is large enough
+  void flushIfFull() { if(mSink && mBuffer.size()>=FLUSH_SIZE) flush(); }
+  /// write buffer to sink, returns false on failure
+  bool flush();
+
+  bool fail() const { return mFail; }
+  explicit operator bool() const { return !mFail; }
+
+  /// contents not yet written to the sink
+  std::string& buffer() { return mBuffer; }
+
+  /// ostream that appends to the buffer, for types only writable with operator<<
+  ///   has the same format flags and locale as the sink
+  /// call syncFromStream() when done writing to it
+  std::ostream& stream();
+  /// append what was written to stream() to the buffer
+  void syncFromStream();
+
+  static const size_t FLUSH_SIZE = 1<<16;
+
+private:
+  CfgWriter(const CfgWriter&);
+  CfgWriter& operator=(const CfgWriter&);
+
+  class StreamAdapter;
+  std::ostream* mSink;
+  std::string mBuffer;
+  bool mFail;
+  bool mTagged;
+  std::unique_ptr<StreamAdapter> mpStream;
+};
+
+/// true for integer and floating point types that are parsed as numbers
+///   (i.e. not bool or character types, which operator>> reads differently)
+template <typename T>
+struct CfgIsNumber{
+  typedef typename std::remove_cv<T>::type U;
+  static const bool value = std::is_arithmetic<U>::value && !std::is_same<U,bool>::value &&
+    !std::is_same<U,char>::value && !std::is_same<U,signed char>::value && !std::is_same<U,unsigned char>::value &&
+    !std::is_same<U,wchar_t>::value && !std::is_same<U,char16_t>::value && !std::is_same<U,char32_t>::value;
+};
+
+/// true for types written to binary as their raw bytes, and as a single
+///   memcpy when in a vector or array
+template <typename T>
+struct CfgIsBulkCopyable{
+  typedef typename std::remove_cv<T>::type U;
+  static const bool value = (std::is_arithmetic<U>::value || std::is_enum<U>::value) &&
+    !std::is_same<U,bool>::value;
+};
+
+template <typename T, size_t N>
+struct CfgIsBulkCopyable< std::array<T,N> >{
+  static const bool value = CfgIsBulkCopyable<T>::value && sizeof(std::array<T,N>)==N*sizeof(T);
+};
+
+/// true for types that setting from text replaces entirely, so the result
+///   doesn't depend on the previous value.  Structs and Lazy are merged into,
+///   other types are read with operator>>.  Used by the include cache
+template <typename T>
+struct CfgSetReplaces{
+  static const bool value = std::is_arithmetic<T>::value;
+};
+template <> struct CfgSetReplaces<std::string>{ static const bool value = true; };
+// containers are cleared, and each element is parsed into a new value
+template <typename T> struct CfgSetReplaces< std::vector<T> >{ static const bool value = true; };
+template <typename T, size_t N> struct CfgSetReplaces< std::array<T,N> >{ static const bool value = true; };
+template <typename T> struct CfgSetReplaces< std::set<T> >{ static const bool value = true; };
+template <typename T1, typename T2> struct CfgSetReplaces< std::map<T1,T2> >{ static const bool value = true; };
+template <typename T, typename H, typename E>
+struct CfgSetReplaces< std::unordered_set<T,H,E> >{ static const bool value = true; };
+template <typename T1, typename T2, typename H, typename E>
+struct CfgSetReplaces< std::unordered_map<T1,T2,H,E> >{ static const bool value = true; };
+template <typename T> struct CfgSetReplaces< std::deque<T> >{ static const bool value = true; };
+template <typename T> struct CfgSetReplaces< std::list<T> >{ static const bool value = true; };
+template <typename T, size_t N> struct CfgSetReplaces< SmallVector<T,N> >{ static const bool value = true; };
+template <typename T1, typename T2>
+struct CfgSetReplaces< std::pair<T1,T2> >{
+  static const bool value = CfgSetReplaces<T1>::value && CfgSetReplaces<T2>::value;
+};
+template <typename T> struct CfgSetReplaces< Optional<T> >{ static const bool value = CfgSetReplaces<T>::value; };
+
+/// entries of a file as parsed by one struct type, kept by the include cache
+struct CfgCachedEntries;
+
+//////////////////////////////////////////////////////////////////
+// CfgEventHandler - receives the events of a streaming parse
+
+/// Receives the events of Configurator::readFileEvents, in the order they are
+///   in the text, without building a struct.  Overload only the calls needed.
+///   Values are unescaped and stripped of spaces, as strings are.  Values in
+///   a list are separated by ',' or whitespace, as for containers, so
+///   "v=[1 2 3]" comes as three values
+class CfgEventHandler{
+public:
+  virtual ~CfgEventHandler(){}
+  /// name of an entry of a struct, before its value, e.g. "a" or "a.b"
+  virtual void key(const std::string& name){}
+  virtual void beginStruct(){}
+  virtual void endStruct(){}
+  virtual void beginList(){}
+  virtual void endList(){}
+  /// value of an entry or element of a list that isn't a struct or a list
+  virtual void value(const std::string& text){}
+};
+
 //////////////////////////////////////////////////////////////////
 // Configurator - virtual base class
 
@@ -48,12 +358,66 @@ class Configurator{
 public:
   /// read and parse file / stream / string
   void readFile(const std::string& filename);
+  /// readFile that also returns the names of all files read, i.e. filename
+  ///   and the files pulled in by "include = filename"
+  void readFile(const std::string& filename, std::vector<std::string>& filesRead);
   void readStream(std::istream& stream);
   void readString(const std::string& str);
   void readString(const char* str, size_t size);
   void readString(const char* str);
   friend std::istream& operator>>(std::istream& is, Configurator& cfg);
 
+  /// Streaming parse, for files too large to hold as a struct.  Files are
+  ///   memory-mapped, so only the part being parsed needs to be in memory.
+  /// readFileElements reads filename like readFile, except that each element
+  ///   of the container entry at path (e.g. "items" or "sub.items") is parsed
+  ///   on its own into a T, the container's element type, and passed to
+  ///   callback instead of being stored
+  template <typename T>
+  void readFileElements(const std::string& filename, const std::string& path,
+      const std::function<void(T&)>& callback){
+    cfgReadFileElements(filename, path, [&callback](CfgReader& in){
+      T element{};
+      cfgSetFromStream(in, element);
+      if(!in.fail()) callback(element);
+    });
+  }
+  /// calls handler for each key, value, struct and list of the file or
+  ///   string, with the syntax of readFile.  "include" entries are passed
+  ///   to handler like any other.  Throws on unbalanced brackets
+  static void readFileEvents(const std::string& filename, CfgEventHandler& handler);
+  static void readStringEvents(const std::string& str, CfgEventHandler& handler);
+
+  /// Parse large vectors of structs or containers on several threads, with
+  ///   the same results and errors as parsing serially.  Applies to all
+  ///   reads on all threads.  1 (the default) parses serially, 0 uses one
+  ///   thread per core
+  static void setParseThreads(unsigned threads);
+  static unsigned getParseThreads();
+  /// Load the files named by "include = filename" on several threads while
+  ///   parsing, instead of one at a time when each include is parsed.
+  ///   Entries are still applied in order.  Applies to all reads on all
+  ///   threads, off by default
+  static void setPrefetchIncludes(bool prefetch);
+  static bool getPrefetchIncludes();
+  /// Keep what each struct type parsed from the files read by readFile in a
+  ///   process-wide cache, so reading a file again (e.g. a fragment included
+  ///   by many structs, or an include on reload) sets the entries from the
+  ///   cache instead of parsing them.  If the file changed, only the entries
+  ///   whose text changed are parsed.  A cached file is checked for changes
+  ///   by its size and modification time, or by a hash of its contents if it
+  ///   was modified just before being cached.  Holds up to 64 MB of files,
+  ///   dropping the least recently read.  Off by default
+  static void setIncludeCache(bool enable);
+  /// entries of cached files read since clearIncludeCache: hits were set
+  ///   from the cache, misses were parsed from text.  Includes, "a.b" keys,
+  ///   Lazy entries and types read with operator>> are always parsed
+  static void getIncludeCacheStats(unsigned long long& hits, unsigned long long& misses);
+  /// empties the include cache and resets its counters
+  static void clearIncludeCache();
+  /// minimum elements per thread for parsing a vector in parallel
+  static const size_t PARALLEL_MIN_ELEMENTS = 256;
+
   /// write contents of struct to file / stream / string
   void writeToFile(const std::string& filename);
   void writeToStream(std::ostream& stream,int indent=0);
@@ -62,9 +426,54 @@ public:
   std::string toString();
   friend std::ostream& operator<<(std::ostream& os, Configurator& cfg);
 
-  /// equality
+  /// compact binary format, e.g. for snapshots.  Entries are written in
+  ///   declaration order without names, numbers in host byte order, so it can
+  ///   only be read back by the same struct definition on the same platform.
+  void writeToBinary(std::string& buffer);
+  void readBinary(const std::string& buffer);
+  void readBinary(const char* data, size_t size);
+
+  /// tagged binary format, for data that must stay readable when the struct
+  ///   changes.  Each entry is written with a field id (a hash of its name)
+  ///   and its size, so entries the reader doesn't know are skipped, and
+  ///   entries missing from the data keep their default values.  Two entry
+  ///   names with the same field id can't be used in this format.
+  /// The header holds the struct name and getSchemaHash() of the writer.
+  ///   readTaggedBinary throws if the struct name differs, and returns true
+  ///   if the schema hash matched, i.e. nothing was skipped or defaulted.
+  void writeToTaggedBinary(std::string& buffer);
+  bool readTaggedBinary(const std::string& buffer);
+  bool readTaggedBinary(const char* data, size_t size);
+  /// reads only the header of tagged binary data, returns false if it isn't
+  ///   tagged binary data
+  static bool readTaggedBinaryHeader(const char* data, size_t size,
+    std::string& structName, unsigned long long& schemaHash);
+  /// hash of the names and types of all entries, including those of nested structs
+  unsigned long long getSchemaHash();
+
+  /// equality, stops comparing at the first difference
   bool operator==(Configurator& other);
   bool operator!=(Configurator& other);
+  /// hash of the values of all entries, equal structs have equal hashes
+  size_t hash();
+  /// names of the entries that differ from those of other, which must be of
+  ///   the same type.  Nested structs are compared entry by entry, giving
+  ///   '.' separated names as used by set(), e.g. "a.b.c".  Other entries,
+  ///   including containers of structs, are reported as a whole.
+  std::vector<std::string> diff(Configurator& other);
+  /// template <typename Visitor> void visit(Visitor& visitor) is generated in
+  ///   each struct by the macros below.  It passes each entry to visitor by
+  ///   reference, recursing into nested structs and containers, see CfgVisitor
+
+  /// write only the entries that differ from baseline, as "a.b.c=value" lines.
+  ///   Reading them into a copy of baseline with readString/readStream gives
+  ///   a struct equal to this one.  An Optional that is set in baseline but
+  ///   not in this struct can't be written as text, use writeBinaryDelta.
+  void writeDelta(Configurator& baseline, std::ostream& stream);
+  /// binary delta, applied to a copy of baseline with readBinaryDelta
+  void writeBinaryDelta(Configurator& baseline, std::string& buffer);
+  void readBinaryDelta(const std::string& buffer);
+  void readBinaryDelta(const char* data, size_t size);
 
   /// set varname = val
   void set(const std::string& varName, const std::string& val);
@@ -78,6 +487,31 @@ public:
 protected:
   enum MFType{CFG_INIT_ALL,CFG_SET,CFG_WRITE_ALL,CFG_COMPARE};
 
+  /// parse struct from reader, e.g. "a=1 b=2}"
+  void cfgReadStruct(CfgReader& in);
+  /// reads "name=" of the next entry of a struct into key.  Returns false
+  ///   past the '}' that ends the struct, or at the end of input, setting fail
+  static bool cfgReadKey(CfgReader& in, std::string& key);
+  /// cfgReadStruct that passes a reader at each element of the container at
+  ///   path to element, instead of setting it, see readFileElements
+  void cfgReadElements(CfgReader& in, const std::string& path,
+    const std::function<void(CfgReader&)>& element);
+  void cfgReadFileElements(const std::string& filename, const std::string& path,
+    const std::function<void(CfgReader&)>& element);
+  /// parse struct / value from reader, calling handler, see readFileEvents
+  static void cfgStructEvents(CfgReader& in, CfgEventHandler& handler);
+  static void cfgValueEvents(CfgReader& in, CfgEventHandler& handler, bool inList=false);
+  /// readFile through the include cache, see setIncludeCache
+  void cfgReadCachedFile(const std::string& filename);
+  /// cfgReadStruct that records each entry in parsed.  Entries whose text
+  ///   is the same as in old are set from old instead of parsed
+  void cfgReadCachedStruct(CfgReader& in, const CfgCachedEntries* old, CfgCachedEntries& parsed);
+  /// sets the entries recorded by cfgReadCachedStruct, of an unchanged file
+  void cfgApplyCached(const CfgCachedEntries& parsed, unsigned threads);
+  friend struct CfgCachedEntries;
+  /// set varname based on contents of reader
+  void cfgSet(const std::string& varName, CfgReader& in);
+
   /// Helper method that is called by all of the public methods above.
   ///   This method is automatically generated in subclass using macros below
   ///   Returns the number of variables matched
@@ -85,17 +519,462 @@ protected:
     std::istream* streamIn, std::ostream* streamOut, int indent, 
     Configurator* other)=0;
 
-  /// return i*2 spaces, for printing
-  static std::string cfgIndentBy(int i);
+  //////////////////////////////////////////////////////////////////
+  // Entry operations
+  // The macros below generate cfgForEachEntry(op), which calls
+  //   op(name, this, &Struct::member) once for each CFG_ENTRY (and recurses
+  //   into CFG_PARENT).  Each operation is a class with that templated
+  //   operator() and a cfgInitDefaults() method.  If cfgInitDefaults()
+  //   returns true, the entries are set to their default values instead.
+
+  /// Operation that implements cfgMultiFunction for the given MFType
+  class CfgMultiFunctionOp{
+  public:
+    CfgMultiFunctionOp(Configurator* self, MFType mfType, std::string* str, std::string* subVar,
+      std::istream* streamIn, std::ostream* streamOut, int indent, Configurator* other)
+      : self(self), mfType(mfType), str(str), subVar(subVar), streamIn(streamIn),
+        streamOut(streamOut), indent(indent), other(other) {}
+
+    bool cfgInitDefaults() const { return mfType==CFG_INIT_ALL; }
+
+    template <typename S, typename C, typename T>
+    int operator()(const char* name, S* obj, T C::* member){
+      T& var = obj->*member;
+      if(mfType==CFG_SET && *str==name) { 
+        CfgIStreamReader in(*streamIn);
+        cfgSetFromStream(in,var,*subVar);
+        return 1;
+      } else if(mfType==CFG_WRITE_ALL) {
+        CfgWriter out(streamOut);
+        CfgWriteOp op(self,out,indent);
+        int retVal = op(name,obj,member);
+        if(!out.flush())
+          self->throwError("Configurator ("+self->getStructName()+") error, can't write variable: "+name);
+        return retVal;
+      }
+      return 0;
+    }
+
+  private:
+    Configurator* self;
+    MFType mfType;
+    std::string *str, *subVar;
+    std::istream* streamIn;
+    std::ostream* streamOut;
+    int indent;
+    Configurator* other;
+  };
+
+  /// Operation that sets each entry to its default value
+  class CfgInitOp{
+  public:
+    bool cfgInitDefaults() const { return true; }
+
+    template <typename S, typename C, typename T>
+    int operator()(const char* name, S* obj, T C::* member){ return 0; }
+  };
+
+  //////////////////////////////////////////////////////////////////
+  // Field lists
+  // CFG_FIELDS declares the entries of a struct as a tuple of CfgFields
+  //   instead of the statements of cfgForEachEntry.  Each operation is then
+  //   a loop over the tuple, unrolled at compile time.
+
+  /// entry of a struct declared with CFG_FIELDS: name, member and default value
+  template <typename C, typename T, typename D>
+  struct CfgField{
+    const char* name;
+    T C::* member;
+    D defaultVal;
+  };
+  /// default value of a CFG_FIELD without one, i.e. cfgGetDefaultVal
+  struct CfgNoDefault{};
+  /// parent of a struct declared with CFG_FIELDS, if it has none
+  struct CfgNoParent{
+    template <typename CfgOp> static int cfgForEachEntry(CfgOp& cfgOp) { return 0; }
+    static int cfgInitEntries() { return 0; }
+  };
+
+  template <typename C, typename T, typename D>
+  static CfgField<C,T,D> cfgField(const char* name, T C::* member, D defaultVal){
+    CfgField<C,T,D> field = { name, member, defaultVal };
+    return field;
+  }
+  template <typename C, typename T>
+  static CfgField<C,T,CfgNoDefault> cfgField(const char* name, T C::* member){
+    CfgField<C,T,CfgNoDefault> field = { name, member, CfgNoDefault() };
+    return field;
+  }
+
+  /// set entry to its default, like CFG_ENTRY_DEF
+  template <typename S, typename C, typename T, typename D>
+  static void cfgInitField(S* obj, const CfgField<C,T,D>& field){
+    T& var = obj->*field.member;
+    if(cfgIsSetOrNotOptional(var)) var = field.defaultVal;
+  }
+  template <typename S, typename C, typename T>
+  static void cfgInitField(S* obj, const CfgField<C,T,CfgNoDefault>& field){
+    T& var = obj->*field.member;
+    if(cfgIsSetOrNotOptional(var)) var = cfgGetDefaultVal(var);
+  }
+
+  /// loops over fields I..N-1 of a field list
+  template <size_t I, size_t N>
+  struct CfgFieldLoop{
+    template <typename S, typename Fields, typename CfgOp>
+    static int forEach(S* obj, const Fields& fields, CfgOp& cfgOp){
+      int retVal = cfgOp(std::get<I>(fields).name, obj, std::get<I>(fields).member);
+      return retVal + CfgFieldLoop<I+1,N>::forEach(obj, fields, cfgOp);
+    }
+    template <typename S, typename Fields>
+    static int init(S* obj, const Fields& fields){
+      cfgInitField(obj, std::get<I>(fields));
+      return 1 + CfgFieldLoop<I+1,N>::init(obj, fields);
+    }
+  };
+  template <size_t N>
+  struct CfgFieldLoop<N,N>{
+    template <typename S, typename Fields, typename CfgOp>
+    static int forEach(S* obj, const Fields& fields, CfgOp& cfgOp) { return 0; }
+    template <typename S, typename Fields>
+    static int init(S* obj, const Fields& fields) { return 0; }
+  };
+
+  /// Operation that writes each entry to a CfgWriter, e.g. "  a=1\n"
+  class CfgWriteOp{
+  public:
+    CfgWriteOp(Configurator* self, CfgWriter& out, int indent)
+      : self(self), out(out), indent(indent) {}
+
+    bool cfgInitDefaults() const { return false; }
+
+    template <typename S, typename C, typename T>
+    int operator()(const char* name, S* obj, T C::* member){
+      T& var = obj->*member;
+      if(!cfgIsSetOrNotOptional(var)) return 0;
+      out.writeIndent(indent);
+      out.write(name);
+      out.put('=');
+      cfgWriteToStreamHelper(out,var,indent);
+      out.put('\n');
+      out.flushIfFull();
+      if(out.fail())
+        self->throwError("Configurator ("+self->getStructName()+") error, can't write variable: "+name);
+      return 1;
+    }
+
+  private:
+    Configurator* self;
+    CfgWriter& out;
+    int indent;
+  };
+
+  /// write entries of struct to writer
+  ///   This method is automatically generated in subclass using macros below
+  virtual int cfgWriteEntries(CfgWriter& out, int indent)=0;
+  /// write struct to writer, with braces if nested (indent>0)
+  void cfgWriteStruct(CfgWriter& out, int indent);
+
+  /// Operation that writes each entry to a CfgWriter in binary
+  class CfgBinaryWriteOp{
+  public:
+    CfgBinaryWriteOp(CfgWriter& out) : out(out) {}
+
+    bool cfgInitDefaults() const { return false; }
+
+    template <typename S, typename C, typename T>
+    int operator()(const char* name, S* obj, T C::* member){
+      cfgWriteBinaryHelper(out, obj->*member);
+      return 1;
+    }
+
+  private:
+    CfgWriter& out;
+  };
+
+  /// Operation that reads each entry from a CfgReader in binary
+  class CfgBinaryReadOp{
+  public:
+    CfgBinaryReadOp(Configurator* self, CfgReader& in) : self(self), in(in) {}
+
+    bool cfgInitDefaults() const { return false; }
+
+    template <typename S, typename C, typename T>
+    int operator()(const char* name, S* obj, T C::* member){
+      cfgReadBinaryHelper(in, obj->*member);
+      if(in.fail())
+        self->throwError("Configurator ("+self->getStructName()+") error, can't read binary variable: "+name);
+      return 1;
+    }
+
+  private:
+    Configurator* self;
+    CfgReader& in;
+  };
+
+  /// Operation that compares each entry with the same entry of other,
+  ///   skipping the rest after the first difference
+  class CfgCompareOp{
+  public:
+    CfgCompareOp(Configurator* other) : other(other), different(false) {}
+
+    bool cfgInitDefaults() const { return false; }
+
+    template <typename S, typename C, typename T>
+    int operator()(const char* name, S* obj, T C::* member){
+      if(different) return 0;
+      different = cfgCompareHelper(obj->*member, static_cast<S*>(other)->*member)!=0;
+      return different ? 1 : 0;
+    }
+
+  private:
+    Configurator* other;
+    bool different;
+  };
+
+  /// compare entries of struct with those of other, which must be of the same type
+  ///   This method is automatically generated in subclass using macros below
+  virtual int cfgCompareEntries(Configurator& other)=0;
+
+  /// Operation that combines the hashes of all entries
+  class CfgHashOp{
+  public:
+    CfgHashOp() : seed(0) {}
+
+    bool cfgInitDefaults() const { return false; }
+
+    template <typename S, typename C, typename T>
+    int operator()(const char* name, S* obj, T C::* member){
+      cfgHashHelper(seed, obj->*member);
+      return 1;
+    }
+
+    size_t seed;
+  };
+
+  /// hash of the entries of struct
+  ///   This method is automatically generated in subclass using macros below
+  virtual size_t cfgHashEntries()=0;
+
+  /// Operation that passes each entry to a visitor, see CfgVisitor
+  template <typename Visitor>
+  class CfgVisitOp{
+  public:
+    CfgVisitOp(Visitor& visitor) : visitor(visitor) {}
+
+    bool cfgInitDefaults() const { return false; }
+
+    template <typename S, typename C, typename T>
+    int operator()(const char* name, S* obj, T C::* member){
+      cfgVisitHelper(visitor, name, obj->*member);
+      return 1;
+    }
+
+  private:
+    Visitor& visitor;
+  };
+
+  /// write / read entries of struct in binary
+  ///   These methods are automatically generated in subclass using macros below
+  virtual int cfgWriteBinaryEntries(CfgWriter& out)=0;
+  virtual int cfgReadBinaryEntries(CfgReader& in)=0;
+
+  /// write / read struct in the tagged binary format: size of the struct, then
+  ///   for each entry its field id (4 bytes), size and value.  Reading sets
+  ///   entries missing from the data to their defaults and skips unknown ones.
+  void cfgWriteTaggedStruct(CfgWriter& out);
+  void cfgReadTaggedStruct(CfgReader& in);
+  /// field id of an entry in the tagged binary format, FNV-1a hash of its name
+  static unsigned cfgFieldId(const char* name);
+
+  /// append description of entries to schema, e.g. "A{x:i4;b:B{...};}", used
+  ///   for getSchemaHash().  stack holds the structs being described, so a
+  ///   recursive struct is described by its name only
+  void cfgWriteSchema(std::string& schema, std::vector<std::string>& stack);
+
+  //////////////////////////////////////////////////////////////////
+  // Key table
+  // Per struct type table mapping variable names to members.
+  // Built once per type on first use, so set() is a binary search instead
+  //   of a string compare against every entry, and the tagged binary format
+  //   finds entries by field id.
+
+  /// Accesses one member of a struct, for the operations that look up
+  ///   members by name or field id
+  class CfgKeyAccessor{
+  public:
+    virtual ~CfgKeyAccessor(){}
+    /// set member from a reader, see cfgSetFromStream
+    virtual void set(Configurator& cfg, CfgReader& in, const std::string& subVar)=0;
+    /// write member as text, see cfgWriteToStreamHelper
+    virtual void writeText(Configurator& cfg, CfgWriter& out, int indent)=0;
+    /// false if member is an Optional that is not set
+    virtual bool isSet(Configurator& cfg)=0;
+    /// member of cfg if it is a struct, else NULL
+    virtual Configurator* nested(Configurator& cfg)=0;
+    /// for the include cache: copy of the member if setting it replaces it
+    ///   (see CfgSetReplaces), else NULL.  assignValue sets it to the copy
+    virtual std::shared_ptr<const void> copyValue(Configurator& cfg)=0;
+    virtual void assignValue(Configurator& cfg, const void* val)=0;
+    /// member of cfg if it is a struct, NULL if not or if it is Lazy
+    virtual Configurator* plainStruct(Configurator& cfg)=0;
+    /// compare member of a and b, see cfgCompareHelper
+    virtual int compare(Configurator& a, Configurator& b)=0;
+    /// write / read member in binary, see cfgWriteBinaryHelper
+    virtual void writeBinary(Configurator& cfg, CfgWriter& out)=0;
+    virtual void readBinary(Configurator& cfg, CfgReader& in)=0;
+    /// append type of member to schema, see cfgSchemaHelper
+    virtual void writeSchema(std::string& schema, std::vector<std::string>& stack)=0;
+  };
+
+  /// CfgKeyAccessor for member of type T declared in C, accessed through struct S
+  template <typename S, typename C, typename T>
+  class CfgMemberKeyAccessor : public CfgKeyAccessor{
+  public:
+    CfgMemberKeyAccessor(T C::* member) : mMember(member) {}
+    void set(Configurator& cfg, CfgReader& in, const std::string& subVar){
+      cfgSetFromStream(in, get(cfg), subVar);
+    }
+    void writeText(Configurator& cfg, CfgWriter& out, int indent){
+      cfgWriteToStreamHelper(out, get(cfg), indent);
+    }
+    bool isSet(Configurator& cfg){
+      return cfgIsSetOrNotOptional(get(cfg));
+    }
+    Configurator* nested(Configurator& cfg){
+      return cfgAsConfigurator(get(cfg));
+    }
+    std::shared_ptr<const void> copyValue(Configurator& cfg){
+      return cfgCopyIfReplaced(get(cfg), std::integral_constant<bool,CfgSetReplaces<T>::value>());
+    }
+    void assignValue(Configurator& cfg, const void* val){
+      cfgAssignIfReplaced(get(cfg), val, std::integral_constant<bool,CfgSetReplaces<T>::value>());
+    }
+    Configurator* plainStruct(Configurator& cfg){
+      return std::is_base_of<Configurator,T>::value ? cfgAsConfigurator(get(cfg)) : NULL;
+    }
+    int compare(Configurator& a, Configurator& b){
+      return cfgCompareHelper(get(a), get(b));
+    }
+    void writeBinary(Configurator& cfg, CfgWriter& out){
+      cfgWriteBinaryHelper(out, get(cfg));
+    }
+    void readBinary(Configurator& cfg, CfgReader& in){
+      cfgReadBinaryHelper(in, get(cfg));
+    }
+    void writeSchema(std::string& schema, std::vector<std::string>& stack){
+      cfgSchemaHelper(schema, (T*)NULL, stack);
+    }
+  private:
+    T& get(Configurator& cfg) { return static_cast<S&>(cfg).*mMember; }
+    T C::* mMember;
+  };
+
+  struct CfgKeyEntry{
+    const char* name;
+    unsigned id;       // cfgFieldId(name)
+    size_t index;      // position in declaration order
+    std::shared_ptr<CfgKeyAccessor> accessor;
+  };
+  static bool cfgLessByName(const CfgKeyEntry& a, const CfgKeyEntry& b) { return strcmp(a.name,b.name)<0; }
+  static bool cfgLessById(const CfgKeyEntry& a, const CfgKeyEntry& b) { return a.id<b.id; }
+
+  struct CfgKeyTable{
+    std::vector<CfgKeyEntry> entries;  // declaration order
+    std::vector<CfgKeyEntry> byName;   // sorted by name
+    std::vector<CfgKeyEntry> byId;     // sorted by field id
+    std::string idCollision;           // "a, b" if entries a and b have the same field id
+    mutable unsigned long long schemaHash;  // 0 until getSchemaHash() is called
+  };
+
+  /// Operation that collects every entry into a CfgKeyTable
+  class CfgKeyTableBuilder{
+  public:
+    CfgKeyTable table;
+
+    bool cfgInitDefaults() const { return false; }
+
+    template <typename S, typename C, typename T>
+    int operator()(const char* name, S* obj, T C::* member){
+      CfgKeyEntry entry = { name, cfgFieldId(name), table.entries.size(),
+        std::make_shared< CfgMemberKeyAccessor<S,C,T> >(member) };
+      table.entries.push_back(entry);
+      return 1;
+    }
+  };
+
+  /// cfgAsConfigurator(val) returns &val if val is a struct, else NULL
+  static Configurator* cfgAsConfigurator(Configurator& cfg) { return &cfg; }
+  template <typename T>
+  static typename std::enable_if<!std::is_base_of<Configurator,T>::value,Configurator*>::type
+    cfgAsConfigurator(T& val) { return NULL; }
+  template <typename T>
+  static Configurator* cfgAsConfigurator(Lazy<T>& lazy) { return cfgAsConfigurator(lazy.get()); }
+
+  /// copy of val for the include cache if setting it replaces it, else NULL
+  template <typename T>
+  static std::shared_ptr<const void> cfgCopyIfReplaced(T& val, std::true_type) { return std::make_shared<T>(val); }
+  template <typename T>
+  static std::shared_ptr<const void> cfgCopyIfReplaced(T& val, std::false_type) { return nullptr; }
+  /// sets val to a copy made by cfgCopyIfReplaced
+  template <typename T>
+  static void cfgAssignIfReplaced(T& val, const void* copy, std::true_type) { val = *static_cast<const T*>(copy); }
+  template <typename T>
+  static void cfgAssignIfReplaced(T& val, const void* copy, std::false_type) {}
+
+  /// builds the key table of struct S, reports duplicate names.  Entries with
+  ///   the same field id are only an error for the tagged binary format
+  template <typename S>
+  static CfgKeyTable cfgBuildKeyTable(S* self){
+    CfgKeyTableBuilder builder;
+    self->cfgForEachEntry(builder);
+    CfgKeyTable& table = builder.table;
+    table.schemaHash = 0;
+    table.byName = table.entries;
+    std::stable_sort(table.byName.begin(), table.byName.end(), cfgLessByName);
+    for(size_t i=1; i<table.byName.size(); i++){
+      if(strcmp(table.byName[i-1].name, table.byName[i].name)==0)
+        self->throwError("Configurator ("+self->getStructName()+") error, multiple keys with the same name not allowed: "+table.byName[i].name);
+    }
+    table.byId = table.entries;
+    std::stable_sort(table.byId.begin(), table.byId.end(), cfgLessById);
+    for(size_t i=1; i<table.byId.size() && table.idCollision.empty(); i++){
+      if(table.byId[i-1].id==table.byId[i].id)
+        table.idCollision = std::string(table.byId[i-1].name)+", "+table.byId[i].name;
+    }
+    return table;
+  }
+
+  /// returns key table for this struct type
+  ///   This method is automatically generated in subclass using macros below
+  virtual const CfgKeyTable& cfgGetKeyTable()=0;
+
+  /// receives the entries found by cfgDiff
+  class CfgDiffHandler{
+  public:
+    virtual ~CfgDiffHandler(){}
+    /// entry of cfg, named path, differs from the other struct
+    virtual void changed(const std::string& path, Configurator& cfg, const CfgKeyEntry& entry)=0;
+  };
+  /// calls handler for each entry that differs from other (of the same type),
+  ///   recursing into nested structs.  path of each entry is prefix+name
+  void cfgDiff(Configurator& other, const std::string& prefix, CfgDiffHandler& handler);
+  /// finds the entry named name in the key table, or returns NULL
+  const CfgKeyEntry* cfgFindKey(const std::string& name);
+  const CfgKeyEntry* cfgFindKey(const char* name, size_t size);
+  /// finds the entry named path ("a.b.c") and the struct it belongs to.
+  ///   Calls throwError and returns NULL if there is none
+  const CfgKeyEntry* cfgFindEntry(const std::string& path, Configurator*& owner);
+
   /// returns default value of type T
   template <typename T> static T cfgGetDefaultVal(const T&var){return T();}
   /// overridable method called on parse error
   virtual void throwError(std::string error){ throw std::runtime_error(error); }
 
   //////////////////////////////////////////////////////////////////
-  // cfgSetFromStream(stream, val, subVar)
-  // Used internally by cfgMultiFunction
-  // Sets value of val based on contents of stream
+  // cfgSetFromStream(in, val, subVar)
+  // Used internally by set() and cfgMultiFunction
+  // Sets value of val based on contents of reader, which is left just past the value
   // subVar is for '.' separated nested structs, e.g. "a.b=5"
   // Overloaded for multiple types: string, configurator descendants, bool, 
   //   pair, various STL containers, and primitives
@@ -103,13 +982,13 @@ protected:
   /// cfgSetFromStream for strings.  
   /// by default, operator>> will only read one word at a time
   /// this instead will read until a delimiter: ,#}]\t\r\n
-  static void cfgSetFromStream(std::istream& ss, std::string& str, const std::string& subVar="");
+  static void cfgSetFromStream(CfgReader& in, std::string& str, const std::string& subVar="");
 
   /// cfgSetFromStream for Configurator descendants
-  static void cfgSetFromStream(std::istream& ss, Configurator& cfg, const std::string& subVar="");
+  static void cfgSetFromStream(CfgReader& in, Configurator& cfg, const std::string& subVar="");
 
   /// cfgSetFromStream for bool (allows (t,true,1,f,false,0))
-  static void cfgSetFromStream(std::istream& ss, bool& b, const std::string& subVar="");
+  static void cfgSetFromStream(CfgReader& in, bool& b, const std::string& subVar="");
 
   /// helper function for cfgSetFromStream for pairs
   /// workaround: a map's value_type is pair<const T1, T2> this casts off the const
@@ -122,167 +1001,740 @@ protected:
   /// element pair separated by whitespace or comma
   /// note: string elements may contain spaces
   template <typename T1, typename T2>
-  static void cfgSetFromStream(std::istream& is, std::pair<T1,T2>& pair, const std::string& subVar=""){
-    cfgSetFromStream(is, remove_const(pair.first), subVar);
-    // push to next element, removing comments
-    while(isspace(is.peek())||is.peek()==','||is.peek()=='#') {
-      std::string dumpStr;
-      if(is.peek()=='#') getline(is,dumpStr);
-      else is.ignore();
-    }
-    cfgSetFromStream(is, pair.second, subVar);
+  static void cfgSetFromStream(CfgReader& in, std::pair<T1,T2>& pair, const std::string& subVar=""){
+    cfgSetFromStream(in, remove_const(pair.first), subVar);
+    in.skipSeparators(); // push to next element, removing comments
+    cfgSetFromStream(in, pair.second, subVar);
   }
 
   /// cfgSetFromStream helper for many STL containers
   /// Parses container from stream of format: "[1 2 3 4 5]" (commas required for strings, optional for others)
   template <typename Container>
-  static void cfgContainerSetFromStream(std::istream& is, Container& container, const std::string& subVar="");
+  static void cfgContainerSetFromStream(CfgReader& in, Container& container, const std::string& subVar="");
 
   /// cfgSetFromStream for vectors
   /// wrapper for cfgContainerSetFromStream
   template <typename T>
-  static void cfgSetFromStream(std::istream& is, std::vector<T>& vec, const std::string& subVar=""){
-    cfgContainerSetFromStream(is, vec, subVar);
+  static void cfgSetFromStream(CfgReader& in, std::vector<T>& vec, const std::string& subVar=""){
+    if(in.parseThreads()!=1 && subVar.empty() && cfgParallelSetFromStream(in, vec)) return;
+    cfgContainerSetFromStream(in, vec, subVar);
   }
 
+  /// parses vec on in.parseThreads() threads.  Returns false without
+  ///   reading anything if it can't, and the caller parses serially
+  template <typename T>
+  static bool cfgParallelSetFromStream(CfgReader& in, std::vector<T>& vec);
+  static bool cfgParallelSetFromStream(CfgReader& in, std::vector<bool>& vec) { return false; }
+  /// bounds of the elements of the container at in.pos(), if each element
+  ///   is a struct or container.  end is set to just past the container
+  static bool cfgScanElements(CfgReader& in, std::vector< std::pair<const char*,const char*> >& elements,
+    const char*& end);
+  /// number of ',' separated items of the container whose '[' is just before p,
+  ///   not counting those of nested structs and containers.  Used to reserve
+  ///   room before parsing, so it undercounts items separated only by spaces
+  static size_t cfgCountItems(const char* p, const char* end);
+  /// calls parse(i, reader) for each element on several threads.  Returns false
+  ///   if there are too few elements, or parsing any element failed or didn't
+  ///   end exactly at the end of the element
+  static bool cfgParseElements(CfgReader& in, const std::vector< std::pair<const char*,const char*> >& elements,
+    const std::function<void(size_t, CfgReader&)>& parse);
+
   /// cfgSetFromStream for stl array
   /// wrapper for cfgContainerSetFromStream
   template <typename T, size_t N>
-  static void cfgSetFromStream(std::istream& is, std::array<T,N>& arr, const std::string& subVar=""){
-    cfgContainerSetFromStream(is, arr, subVar);
+  static void cfgSetFromStream(CfgReader& in, std::array<T,N>& arr, const std::string& subVar=""){
+    cfgContainerSetFromStream(in, arr, subVar);
   }
 
   /// cfgSetFromStream for sets
   /// wrapper for cfgContainerSetFromStream
   template <typename T>
-  static void cfgSetFromStream(std::istream& is, std::set<T>& set, const std::string& subVar=""){
-    cfgContainerSetFromStream(is, set, subVar);
+  static void cfgSetFromStream(CfgReader& in, std::set<T>& set, const std::string& subVar=""){
+    cfgContainerSetFromStream(in, set, subVar);
   }
 
   /// cfgSetFromStream for map 
   /// Parses map from stream of format: "[key1, val1, key2, val2]" 
   /// wrapper for cfgContainerSetFromStream
   template <typename T1, typename T2>
-  static void cfgSetFromStream(std::istream& is, std::map<T1,T2>& map, const std::string& subVar=""){
-    cfgContainerSetFromStream(is, map, subVar);
+  static void cfgSetFromStream(CfgReader& in, std::map<T1,T2>& map, const std::string& subVar=""){
+    cfgContainerSetFromStream(in, map, subVar);
   }  
 
+  /// cfgSetFromStream for unordered_set, same format as set
+  template <typename T, typename H, typename E>
+  static void cfgSetFromStream(CfgReader& in, std::unordered_set<T,H,E>& set, const std::string& subVar=""){
+    cfgContainerSetFromStream(in, set, subVar);
+  }
+
+  /// cfgSetFromStream for unordered_map, same format as map
+  template <typename T1, typename T2, typename H, typename E>
+  static void cfgSetFromStream(CfgReader& in, std::unordered_map<T1,T2,H,E>& map, const std::string& subVar=""){
+    cfgContainerSetFromStream(in, map, subVar);
+  }
+
+  /// cfgSetFromStream for deque, same format as vector
+  template <typename T>
+  static void cfgSetFromStream(CfgReader& in, std::deque<T>& deq, const std::string& subVar=""){
+    cfgContainerSetFromStream(in, deq, subVar);
+  }
+
+  /// cfgSetFromStream for list, same format as vector
+  template <typename T>
+  static void cfgSetFromStream(CfgReader& in, std::list<T>& list, const std::string& subVar=""){
+    cfgContainerSetFromStream(in, list, subVar);
+  }
+
+  /// cfgSetFromStream for SmallVector, same format as vector
+  template <typename T, size_t N>
+  static void cfgSetFromStream(CfgReader& in, SmallVector<T,N>& vec, const std::string& subVar=""){
+    cfgContainerSetFromStream(in, vec, subVar);
+  }
+
   /// cfgSetFromStream for Optional<T>
   template <typename T>
-  static void cfgSetFromStream(std::istream& is, Optional<T>& val, const std::string& subVar=""){
-    cfgSetFromStream(is, (T&)val, subVar);
+  static void cfgSetFromStream(CfgReader& in, Optional<T>& val, const std::string& subVar=""){
+    cfgSetFromStream(in, (T&)val, subVar);
+  }
+
+  /// cfgSetFromStream for Lazy<T>.  A struct or container is only bracket
+  ///   matched and its text kept for cfgParseLazy on first access
+  template <typename T>
+  static void cfgSetFromStream(CfgReader& in, Lazy<T>& lazy, const std::string& subVar=""){
+    in.skipSpaces();
+    const char* end = subVar.empty() ? cfgMatchBracket(in.pos(), in.end()) : NULL;
+    if(!end) { // scalar, or "a.b=1" format
+      cfgSetFromStream(in, lazy.get(), subVar);
+      return;
+    }
+    lazy.addText(std::string(in.pos(), end), &cfgParseLazy<T>);
+    in.setPos(end);
+  }
+
+  /// parses the text kept by Lazy<T>
+  template <typename T>
+  static void cfgParseLazy(T& val, const std::string& text){
+    CfgReader in(text.data(), text.data()+text.size());
+    cfgSetFromStream(in, val);
+    if(in.fail()) throw std::runtime_error("Configurator error, parse error in lazy entry: "+text.substr(0,40));
   }
 
-  /// cfgSetFromStream for all other types
-  /// the enable_if is required to prevent it from matching on Configurator descendants
+  /// end of the struct or container that starts at p, just past its closing
+  ///   bracket, skipping escaped characters and comments.  NULL if p isn't
+  ///   at '{' or '[', or there is no closing bracket
+  static const char* cfgMatchBracket(const char* p, const char* end);
+
+  /// cfgSetFromStream for integers
+  /// locale free, accepts same format as operator>> with std::setbase(0)
   template <typename T>
-  static typename std::enable_if<!std::is_base_of<Configurator,T>::value,void>::type
-    cfgSetFromStream(std::istream& ss,  T& val, const std::string& subVar=""){
+  static typename std::enable_if<CfgIsNumber<T>::value && std::is_integral<T>::value,void>::type
+    cfgSetFromStream(CfgReader& in,  T& val, const std::string& subVar=""){
+      unsigned long long mag;
+      bool neg;
+      if(!subVar.empty() || !in.readInteger(mag,neg)) { //subVar should be empty
+        in.setFail(); //set fail to trigger error handling
+        return;
+      }
+      // range check. like operator>>, negative unsigned values wrap around
+      unsigned long long maxMag = (unsigned long long)std::numeric_limits<T>::max();
+      if(std::is_signed<T>::value && neg) maxMag++;
+      if(mag>maxMag) {
+        in.setFail();
+        return;
+      }
+      val = neg ? T(0-mag) : T(mag);
+  }
+
+  /// cfgSetFromStream for float and double
+  /// locale free, accepts same format as operator>>
+  template <typename T>
+  static typename std::enable_if<std::is_same<T,float>::value || std::is_same<T,double>::value,void>::type
+    cfgSetFromStream(CfgReader& in,  T& val, const std::string& subVar=""){
+      if(!subVar.empty() || !in.readNumber(val)) { //subVar should be empty
+        in.setFail(); //set fail to trigger error handling
+      }
+  }
+
+  /// cfgSetFromStream for all other types, parsed with operator>>
+  /// the enable_if is required to prevent it from matching on Configurator descendants and numbers
+  template <typename T>
+  static typename std::enable_if<!std::is_base_of<Configurator,T>::value && 
+    !(CfgIsNumber<T>::value && !std::is_same<T,long double>::value),void>::type
+    cfgSetFromStream(CfgReader& in,  T& val, const std::string& subVar=""){
       if(!subVar.empty()) { //subVar should be empty
-        ss.setstate(std::ios::failbit); //set fail bit to trigger error handling
+        in.setFail(); //set fail to trigger error handling
         return;
       }
-      ss>>std::setbase(0)>>val;
+      in.stream()>>std::setbase(0)>>val;
+      in.syncFromStream();
   }
 
   //////////////////////////////////////////////////////////////////
-  // cfgWriteToStreamHelper(stream, val, indent)
-  // Used internally by cfgMultiFunction
-  // Writes the contents of val to the stream
+  // cfgWriteToStreamHelper(out, val, indent)
+  // Used internally by writeToStream and cfgMultiFunction
+  // Writes the contents of val to the writer
   // Overloaded for multiple types: string, configurator descendants, bool, 
   //   pair, various STL containers, and primitives
 
   /// cfgWriteToStreamHelper for string 
-  static void cfgWriteToStreamHelper(std::ostream& stream, std::string& str, int indent);
+  static void cfgWriteToStreamHelper(CfgWriter& out, std::string& str, int indent);
 
   /// cfgWriteToStreamHelper for descendants of Configurator
-  static void cfgWriteToStreamHelper(std::ostream& stream, Configurator& cfg, int indent);
+  static void cfgWriteToStreamHelper(CfgWriter& out, Configurator& cfg, int indent);
 
   /// cfgWriteToStreamHelper for bool (writes true/false)
-  static void cfgWriteToStreamHelper(std::ostream& stream, bool& b, int indent);
+  static void cfgWriteToStreamHelper(CfgWriter& out, bool& b, int indent);
 
   /// cfgWriteToStreamHelper for std::pair
   template <typename T1, typename T2>
-  static void cfgWriteToStreamHelper(std::ostream& stream, std::pair<T1,T2>& pair, int indent){
-    cfgWriteToStreamHelper(stream, pair.first, indent);
-    stream << ",";
-    cfgWriteToStreamHelper(stream, pair.second, indent);
+  static void cfgWriteToStreamHelper(CfgWriter& out, std::pair<T1,T2>& pair, int indent){
+    cfgWriteToStreamHelper(out, pair.first, indent);
+    out.put(',');
+    cfgWriteToStreamHelper(out, pair.second, indent);
   }
 
   /// cfgWriteToStreamHelper for anything with iterators
-  /// Prints container to stream in format: "[1,2,3,4,5]"
+  /// Prints container to writer in format: "[1,2,3,4,5]"
   template <typename Container>
-  static void cfgContainerWriteToStreamHelper(std::ostream& stream, Container& container, int indent);
+  static void cfgContainerWriteToStreamHelper(CfgWriter& out, Container& container, int indent);
 
   /// cfgWriteToStreamHelper for vectors
-  /// Prints vector to stream in format: "[1,2,3,4,5]"
+  /// Prints vector to writer in format: "[1,2,3,4,5]"
   template <typename T>
-  static void cfgWriteToStreamHelper(std::ostream& stream, std::vector<T>& vec, int indent){
-    cfgContainerWriteToStreamHelper(stream, vec, indent);
+  static void cfgWriteToStreamHelper(CfgWriter& out, std::vector<T>& vec, int indent){
+    cfgContainerWriteToStreamHelper(out, vec, indent);
   }
 
   /// cfgWriteToStreamHelper for stl array
-  /// Prints array to stream in format: "[1,2,3,4,5]"
+  /// Prints array to writer in format: "[1,2,3,4,5]"
   template <typename T, size_t N>
-  static void cfgWriteToStreamHelper(std::ostream& stream, std::array<T,N>& vec, int indent){
-    cfgContainerWriteToStreamHelper(stream, vec, indent);
+  static void cfgWriteToStreamHelper(CfgWriter& out, std::array<T,N>& vec, int indent){
+    cfgContainerWriteToStreamHelper(out, vec, indent);
   }
 
   /// cfgWriteToStreamHelper for sets
-  /// Prints set to stream in format: "[1,2,3,4,5]"
+  /// Prints set to writer in format: "[1,2,3,4,5]"
   template <typename T>
-  static void cfgWriteToStreamHelper(std::ostream& stream, std::set<T>& set, int indent){
-    cfgContainerWriteToStreamHelper(stream, set, indent);
+  static void cfgWriteToStreamHelper(CfgWriter& out, std::set<T>& set, int indent){
+    cfgContainerWriteToStreamHelper(out, set, indent);
   }
 
   /// cfgWriteToStreamHelper for maps
-  /// Prints map to stream in format: "[key1,val1,key2,val2]"
+  /// Prints map to writer in format: "[key1,val1,key2,val2]"
   template <typename T1, typename T2>
-  static void cfgWriteToStreamHelper(std::ostream& stream, std::map<T1,T2>& map, int indent){
-    cfgContainerWriteToStreamHelper(stream, map, indent);
+  static void cfgWriteToStreamHelper(CfgWriter& out, std::map<T1,T2>& map, int indent){
+    cfgContainerWriteToStreamHelper(out, map, indent);
+  }
+
+  /// cfgWriteToStreamHelper for unordered_set, in iteration order
+  template <typename T, typename H, typename E>
+  static void cfgWriteToStreamHelper(CfgWriter& out, std::unordered_set<T,H,E>& set, int indent){
+    cfgContainerWriteToStreamHelper(out, set, indent);
+  }
+
+  /// cfgWriteToStreamHelper for unordered_map, in iteration order
+  template <typename T1, typename T2, typename H, typename E>
+  static void cfgWriteToStreamHelper(CfgWriter& out, std::unordered_map<T1,T2,H,E>& map, int indent){
+    cfgContainerWriteToStreamHelper(out, map, indent);
+  }
+
+  template <typename T>
+  static void cfgWriteToStreamHelper(CfgWriter& out, std::deque<T>& deq, int indent){
+    cfgContainerWriteToStreamHelper(out, deq, indent);
+  }
+
+  template <typename T>
+  static void cfgWriteToStreamHelper(CfgWriter& out, std::list<T>& list, int indent){
+    cfgContainerWriteToStreamHelper(out, list, indent);
+  }
+
+  template <typename T, size_t N>
+  static void cfgWriteToStreamHelper(CfgWriter& out, SmallVector<T,N>& vec, int indent){
+    cfgContainerWriteToStreamHelper(out, vec, indent);
   }
 
   /// cfgWriteToStreamHelper for Optional<T>
   /// Prints contents of Optional.
   template <typename T>
-  static void cfgWriteToStreamHelper(std::ostream& stream, Optional<T>& opt, int indent){
+  static void cfgWriteToStreamHelper(CfgWriter& out, Optional<T>& opt, int indent){
     // shouldn't be able to get this far if not set
     if(!opt.isSet()) throw std::runtime_error("cfgWriteToStreamHelper Optional<T>: this shouldn't happen");
-    cfgWriteToStreamHelper(stream, (T&)opt, indent);
+    cfgWriteToStreamHelper(out, (T&)opt, indent);
+  }
+
+  /// cfgWriteToStreamHelper for Lazy<T>, parsed first
+  template <typename T>
+  static void cfgWriteToStreamHelper(CfgWriter& out, Lazy<T>& lazy, int indent){
+    cfgWriteToStreamHelper(out, lazy.get(), indent);
+  }
+
+  /// cfgWriteToStreamHelper for integers, locale free
+  template <typename T>
+  static typename std::enable_if<CfgIsNumber<T>::value && std::is_integral<T>::value,void>::type
+    cfgWriteToStreamHelper(CfgWriter& out, T& val, int indent){
+      bool neg = val<T(0);
+      out.writeInteger(neg ? 0-(unsigned long long)val : (unsigned long long)val, neg);
+  }
+
+  /// cfgWriteToStreamHelper for float and double
+  /// locale free, shortest representation that reads back to the same value
+  template <typename T>
+  static typename std::enable_if<CfgIsNumber<T>::value && std::is_floating_point<T>::value &&
+    !std::is_same<typename std::remove_cv<T>::type,long double>::value,void>::type
+    cfgWriteToStreamHelper(CfgWriter& out, T& val, int indent){
+      out.writeNumber(val);
+  }
+
+  /// cfgWriteToStreamHelper for all other types, written with operator<<
+  /// the enable_if is required to prevent it from matching on Configurator descendants and numbers
+  template <typename T>
+  static typename std::enable_if<!std::is_base_of<Configurator,T>::value && 
+    !(CfgIsNumber<T>::value && !std::is_same<typename std::remove_cv<T>::type,long double>::value),void>::type
+    cfgWriteToStreamHelper(CfgWriter& out, T& val, int indent){
+      out.stream()<<val;
+      out.syncFromStream();
+  }
+
+  //////////////////////////////////////////////////////////////////
+  // cfgWriteBinaryHelper(out, val) and cfgReadBinaryHelper(in, val)
+  // Used internally by writeToBinary and readBinary
+  // Numbers and enums are written as raw bytes, strings and variable size
+  //   containers are prefixed with their size as a varint.  Overloaded for
+  //   the same types as cfgWriteToStreamHelper.  Other types are written as
+  //   their text representation.
+
+  /// cfgWriteBinaryHelper for numbers and enums
+  template <typename T>
+  static typename std::enable_if<CfgIsBulkCopyable<T>::value,void>::type
+    cfgWriteBinaryHelper(CfgWriter& out, T& val){
+      out.write((const char*)&val, sizeof(T));
+  }
+
+  /// cfgWriteBinaryHelper for bool, one byte
+  static void cfgWriteBinaryHelper(CfgWriter& out, bool& b){
+    out.put(b ? 1 : 0);
+  }
+
+  /// cfgWriteBinaryHelper for string, size then chars
+  static void cfgWriteBinaryHelper(CfgWriter& out, std::string& str){
+    out.writeVarint(str.size());
+    out.write(str);
+  }
+
+  /// cfgWriteBinaryHelper for descendants of Configurator
+  static void cfgWriteBinaryHelper(CfgWriter& out, Configurator& cfg){
+    if(out.tagged()) cfg.cfgWriteTaggedStruct(out);
+    else             cfg.cfgWriteBinaryEntries(out);
+  }
+
+  /// cfgWriteBinaryHelper for std::pair
+  template <typename T1, typename T2>
+  static void cfgWriteBinaryHelper(CfgWriter& out, std::pair<T1,T2>& pair){
+    cfgWriteBinaryHelper(out, remove_const(pair.first));
+    cfgWriteBinaryHelper(out, pair.second);
+  }
+
+  /// cfgWriteBinaryHelper for n elements, a single memcpy for bulk copyable types
+  template <typename T>
+  static typename std::enable_if<CfgIsBulkCopyable<T>::value,void>::type
+    cfgWriteBinaryElements(CfgWriter& out, T* data, size_t n){
+      out.write((const char*)data, n*sizeof(T));
+  }
+
+  template <typename T>
+  static typename std::enable_if<!CfgIsBulkCopyable<T>::value,void>::type
+    cfgWriteBinaryElements(CfgWriter& out, T* data, size_t n){
+      for(size_t i=0; i<n; i++) cfgWriteBinaryHelper(out, data[i]);
+  }
+
+  /// cfgWriteBinaryHelper for anything with iterators, size then elements
+  template <typename Container>
+  static void cfgContainerWriteBinaryHelper(CfgWriter& out, Container& c){
+    out.writeVarint(c.size());
+    for(typename Container::iterator i=c.begin(); i!=c.end(); i++)
+      cfgWriteBinaryHelper(out, remove_const(*i));
+  }
+
+  /// cfgWriteBinaryHelper for vectors, size then elements
+  template <typename T>
+  static void cfgWriteBinaryHelper(CfgWriter& out, std::vector<T>& vec){
+    out.writeVarint(vec.size());
+    if(!vec.empty()) cfgWriteBinaryElements(out, &vec[0], vec.size());
+  }
+
+  /// cfgWriteBinaryHelper for stl array, elements only
+  template <typename T, size_t N>
+  static void cfgWriteBinaryHelper(CfgWriter& out, std::array<T,N>& arr){
+    cfgWriteBinaryElements(out, arr.data(), N);
+  }
+
+  /// cfgWriteBinaryHelper for sets
+  template <typename T>
+  static void cfgWriteBinaryHelper(CfgWriter& out, std::set<T>& set){
+    cfgContainerWriteBinaryHelper(out, set);
+  }
+
+  /// cfgWriteBinaryHelper for maps
+  template <typename T1, typename T2>
+  static void cfgWriteBinaryHelper(CfgWriter& out, std::map<T1,T2>& map){
+    cfgContainerWriteBinaryHelper(out, map);
+  }
+
+  template <typename T, typename H, typename E>
+  static void cfgWriteBinaryHelper(CfgWriter& out, std::unordered_set<T,H,E>& set){
+    cfgContainerWriteBinaryHelper(out, set);
+  }
+
+  template <typename T1, typename T2, typename H, typename E>
+  static void cfgWriteBinaryHelper(CfgWriter& out, std::unordered_map<T1,T2,H,E>& map){
+    cfgContainerWriteBinaryHelper(out, map);
+  }
+
+  template <typename T>
+  static void cfgWriteBinaryHelper(CfgWriter& out, std::deque<T>& deq){
+    cfgContainerWriteBinaryHelper(out, deq);
+  }
+
+  template <typename T>
+  static void cfgWriteBinaryHelper(CfgWriter& out, std::list<T>& list){
+    cfgContainerWriteBinaryHelper(out, list);
+  }
+
+  /// cfgWriteBinaryHelper for SmallVector, same as vector
+  template <typename T, size_t N>
+  static void cfgWriteBinaryHelper(CfgWriter& out, SmallVector<T,N>& vec){
+    out.writeVarint(vec.size());
+    if(!vec.empty()) cfgWriteBinaryElements(out, vec.data(), vec.size());
+  }
+
+  /// cfgWriteBinaryHelper for Lazy<T>, same as T
+  template <typename T>
+  static void cfgWriteBinaryHelper(CfgWriter& out, Lazy<T>& lazy){
+    cfgWriteBinaryHelper(out, lazy.get());
+  }
+
+  /// cfgWriteBinaryHelper for Optional<T>, a set flag byte then the value if set
+  template <typename T>
+  static void cfgWriteBinaryHelper(CfgWriter& out, Optional<T>& opt){
+    out.put(opt.isSet() ? 1 : 0);
+    if(opt.isSet()) cfgWriteBinaryHelper(out, (T&)opt);
+  }
+
+  /// cfgWriteBinaryHelper for all other types, as text written with cfgWriteToStreamHelper
+  template <typename T>
+  static typename std::enable_if<!std::is_base_of<Configurator,T>::value && !CfgIsBulkCopyable<T>::value,void>::type
+    cfgWriteBinaryHelper(CfgWriter& out, T& val){
+      CfgWriter text;
+      cfgWriteToStreamHelper(text, val, 0);
+      cfgWriteBinaryHelper(out, text.buffer());
+  }
+
+  /// cfgReadBinaryHelper for numbers and enums
+  template <typename T>
+  static typename std::enable_if<CfgIsBulkCopyable<T>::value,void>::type
+    cfgReadBinaryHelper(CfgReader& in, T& val){
+      in.read(&val, sizeof(T));
+  }
+
+  /// cfgReadBinaryHelper for bool
+  static void cfgReadBinaryHelper(CfgReader& in, bool& b){
+    unsigned char c = 0;
+    if(in.read(&c, 1) && c>1) in.setFail();
+    b = c!=0;
+  }
+
+  /// cfgReadBinaryHelper for string
+  static void cfgReadBinaryHelper(CfgReader& in, std::string& str){
+    unsigned long long size;
+    if(!in.readVarint(size)) return;
+    if(size>in.remaining()) { in.setFail(); return; }
+    str.assign(in.pos(), (size_t)size);
+    in.setPos(in.pos()+size);
+  }
+
+  /// cfgReadBinaryHelper for descendants of Configurator
+  static void cfgReadBinaryHelper(CfgReader& in, Configurator& cfg){
+    if(in.tagged()) cfg.cfgReadTaggedStruct(in);
+    else            cfg.cfgReadBinaryEntries(in);
+  }
+
+  /// cfgReadBinaryHelper for std::pair
+  template <typename T1, typename T2>
+  static void cfgReadBinaryHelper(CfgReader& in, std::pair<T1,T2>& pair){
+    cfgReadBinaryHelper(in, remove_const(pair.first));
+    cfgReadBinaryHelper(in, pair.second);
+  }
+
+  /// cfgReadBinaryHelper for n elements, a single memcpy for bulk copyable types
+  template <typename T>
+  static typename std::enable_if<CfgIsBulkCopyable<T>::value,void>::type
+    cfgReadBinaryElements(CfgReader& in, T* data, size_t n){
+      in.read(data, n*sizeof(T));
+  }
+
+  template <typename T>
+  static typename std::enable_if<!CfgIsBulkCopyable<T>::value,void>::type
+    cfgReadBinaryElements(CfgReader& in, T* data, size_t n){
+      for(size_t i=0; i<n && !in.fail(); i++) cfgReadBinaryHelper(in, data[i]);
+  }
+
+  /// cfgReadBinaryHelper for anything with iterators, inserts each element at the end
+  template <typename Container>
+  static void cfgContainerReadBinaryHelper(CfgReader& in, Container& c){
+    unsigned long long size;
+    if(!in.readVarint(size)) return;
+    c.clear();
+    // capped by the bytes left, so a corrupt size can't reserve a huge amount
+    reserve_helper(c, (size_t)std::min<unsigned long long>(size, in.remaining()));
+    for(unsigned long long i=0; i<size && !in.fail(); i++){
+      typename CfgParseType<typename Container::value_type>::type val;
+      cfgReadBinaryHelper(in, val);
+      if(!in.fail()) c.insert(c.end(), std::move(val));
+    }
+  }
+
+  /// cfgReadBinaryHelper for vectors
+  template <typename T>
+  static void cfgReadBinaryHelper(CfgReader& in, std::vector<T>& vec){
+    if(!CfgIsBulkCopyable<T>::value) {
+      cfgContainerReadBinaryHelper(in, vec);
+      return;
+    }
+    unsigned long long size;
+    if(!in.readVarint(size)) return;
+    if(size>in.remaining()/sizeof(T)) { in.setFail(); return; }
+    vec.resize((size_t)size);
+    if(size) cfgReadBinaryElements(in, &vec[0], vec.size());
+  }
+
+  /// cfgReadBinaryHelper for stl array
+  template <typename T, size_t N>
+  static void cfgReadBinaryHelper(CfgReader& in, std::array<T,N>& arr){
+    cfgReadBinaryElements(in, arr.data(), N);
+  }
+
+  /// cfgReadBinaryHelper for sets
+  template <typename T>
+  static void cfgReadBinaryHelper(CfgReader& in, std::set<T>& set){
+    cfgContainerReadBinaryHelper(in, set);
+  }
+
+  /// cfgReadBinaryHelper for maps
+  template <typename T1, typename T2>
+  static void cfgReadBinaryHelper(CfgReader& in, std::map<T1,T2>& map){
+    cfgContainerReadBinaryHelper(in, map);
+  }
+
+  template <typename T, typename H, typename E>
+  static void cfgReadBinaryHelper(CfgReader& in, std::unordered_set<T,H,E>& set){
+    cfgContainerReadBinaryHelper(in, set);
+  }
+
+  template <typename T1, typename T2, typename H, typename E>
+  static void cfgReadBinaryHelper(CfgReader& in, std::unordered_map<T1,T2,H,E>& map){
+    cfgContainerReadBinaryHelper(in, map);
+  }
+
+  template <typename T>
+  static void cfgReadBinaryHelper(CfgReader& in, std::deque<T>& deq){
+    cfgContainerReadBinaryHelper(in, deq);
+  }
+
+  template <typename T>
+  static void cfgReadBinaryHelper(CfgReader& in, std::list<T>& list){
+    cfgContainerReadBinaryHelper(in, list);
+  }
+
+  /// cfgReadBinaryHelper for SmallVector, same as vector
+  template <typename T, size_t N>
+  static void cfgReadBinaryHelper(CfgReader& in, SmallVector<T,N>& vec){
+    if(!CfgIsBulkCopyable<T>::value) {
+      cfgContainerReadBinaryHelper(in, vec);
+      return;
+    }
+    unsigned long long size;
+    if(!in.readVarint(size)) return;
+    if(size>in.remaining()/sizeof(T)) { in.setFail(); return; }
+    vec.resize((size_t)size);
+    if(size) cfgReadBinaryElements(in, vec.data(), vec.size());
+  }
+
+  /// cfgReadBinaryHelper for Lazy<T>, read right away
+  template <typename T>
+  static void cfgReadBinaryHelper(CfgReader& in, Lazy<T>& lazy){
+    cfgReadBinaryHelper(in, lazy.get());
+  }
+
+  /// cfgReadBinaryHelper for Optional<T>
+  template <typename T>
+  static void cfgReadBinaryHelper(CfgReader& in, Optional<T>& opt){
+    bool isSet;
+    cfgReadBinaryHelper(in, isSet);
+    if(in.fail()) return;
+    if(isSet) cfgReadBinaryHelper(in, opt.get());
+    else      opt.unset();
+  }
+
+  /// cfgReadBinaryHelper for all other types, parsed from text with cfgSetFromStream
+  template <typename T>
+  static typename std::enable_if<!std::is_base_of<Configurator,T>::value && !CfgIsBulkCopyable<T>::value,void>::type
+    cfgReadBinaryHelper(CfgReader& in, T& val){
+      std::string text;
+      cfgReadBinaryHelper(in, text);
+      if(in.fail()) return;
+      CfgReader textIn(text.data(), text.data()+text.size());
+      cfgSetFromStream(textIn, val);
+      if(textIn.fail()) in.setFail();
+  }
+
+  //////////////////////////////////////////////////////////////////
+  // cfgSchemaHelper(schema, (T*)NULL, stack)
+  // Used internally by getSchemaHash
+  // Appends a description of type T to schema, e.g. "v<i4>" for vector<int>
+  // Overloaded for the same types as cfgWriteBinaryHelper
+
+  /// cfgSchemaHelper for numbers and enums: kind and size, e.g. "i4", "u8", "f8", "e4"
+  template <typename T>
+  static typename std::enable_if<CfgIsBulkCopyable<T>::value,void>::type
+    cfgSchemaHelper(std::string& schema, T*, std::vector<std::string>& stack){
+      typedef typename std::remove_cv<T>::type U;
+      schema += std::is_enum<U>::value ? 'e' : std::is_floating_point<U>::value ? 'f' :
+        std::is_signed<U>::value ? 'i' : 'u';
+      schema += std::to_string(sizeof(T));
+  }
+
+  /// cfgSchemaHelper for bool
+  static void cfgSchemaHelper(std::string& schema, bool*, std::vector<std::string>& stack){
+    schema += 'b';
+  }
+
+  /// cfgSchemaHelper for string
+  static void cfgSchemaHelper(std::string& schema, std::string*, std::vector<std::string>& stack){
+    schema += 's';
+  }
+
+  /// cfgSchemaHelper for descendants of Configurator, names and types of the entries
+  template <typename T>
+  static typename std::enable_if<std::is_base_of<Configurator,T>::value,void>::type
+    cfgSchemaHelper(std::string& schema, T*, std::vector<std::string>& stack){
+      T cfg;
+      static_cast<Configurator&>(cfg).cfgWriteSchema(schema, stack);
+  }
+
+  /// cfgSchemaHelper for std::pair
+  template <typename T1, typename T2>
+  static void cfgSchemaHelper(std::string& schema, std::pair<T1,T2>*, std::vector<std::string>& stack){
+    schema += "p<";
+    cfgSchemaHelper(schema, (typename std::remove_const<T1>::type*)NULL, stack);
+    schema += ',';
+    cfgSchemaHelper(schema, (T2*)NULL, stack);
+    schema += '>';
+  }
+
+  /// cfgSchemaHelper for containers, kind then element type, e.g. "v<i4>"
+  template <typename T>
+  static void cfgContainerSchemaHelper(std::string& schema, const char* kind, T*, std::vector<std::string>& stack){
+    schema += kind;
+    schema += '<';
+    cfgSchemaHelper(schema, (T*)NULL, stack);
+    schema += '>';
+  }
+
+  template <typename T>
+  static void cfgSchemaHelper(std::string& schema, std::vector<T>*, std::vector<std::string>& stack){
+    cfgContainerSchemaHelper(schema, "v", (T*)NULL, stack);
+  }
+
+  template <typename T, size_t N>
+  static void cfgSchemaHelper(std::string& schema, std::array<T,N>*, std::vector<std::string>& stack){
+    cfgContainerSchemaHelper(schema, ("a"+std::to_string(N)).c_str(), (T*)NULL, stack);
+  }
+
+  template <typename T>
+  static void cfgSchemaHelper(std::string& schema, std::set<T>*, std::vector<std::string>& stack){
+    cfgContainerSchemaHelper(schema, "S", (T*)NULL, stack);
+  }
+
+  template <typename T1, typename T2>
+  static void cfgSchemaHelper(std::string& schema, std::map<T1,T2>*, std::vector<std::string>& stack){
+    cfgContainerSchemaHelper(schema, "m", (std::pair<T1,T2>*)NULL, stack);
+  }
+
+  /// the other sequences and unordered containers have the same binary format
+  ///   as vector, set and map, so a member can switch between them
+  template <typename T>
+  static void cfgSchemaHelper(std::string& schema, std::deque<T>*, std::vector<std::string>& stack){
+    cfgContainerSchemaHelper(schema, "v", (T*)NULL, stack);
+  }
+
+  template <typename T>
+  static void cfgSchemaHelper(std::string& schema, std::list<T>*, std::vector<std::string>& stack){
+    cfgContainerSchemaHelper(schema, "v", (T*)NULL, stack);
+  }
+
+  template <typename T, size_t N>
+  static void cfgSchemaHelper(std::string& schema, SmallVector<T,N>*, std::vector<std::string>& stack){
+    cfgContainerSchemaHelper(schema, "v", (T*)NULL, stack);
+  }
+
+  template <typename T, typename H, typename E>
+  static void cfgSchemaHelper(std::string& schema, std::unordered_set<T,H,E>*, std::vector<std::string>& stack){
+    cfgContainerSchemaHelper(schema, "S", (T*)NULL, stack);
+  }
+
+  template <typename T1, typename T2, typename H, typename E>
+  static void cfgSchemaHelper(std::string& schema, std::unordered_map<T1,T2,H,E>*, std::vector<std::string>& stack){
+    cfgContainerSchemaHelper(schema, "m", (std::pair<T1,T2>*)NULL, stack);
   }
 
-  /// cfgWriteToStreamHelper for all other types
-  /// the enable_if is required to prevent it from matching on Configurator descendants
+  /// Lazy<T> is stored as T, so a member can switch between them
   template <typename T>
-  static typename std::enable_if<!std::is_base_of<Configurator,T>::value,void>::type
-    cfgWriteToStreamHelper(std::ostream& stream, T& val, int indent){
-      stream<<val;
+  static void cfgSchemaHelper(std::string& schema, Lazy<T>*, std::vector<std::string>& stack){
+    cfgSchemaHelper(schema, (T*)NULL, stack);
+  }
+
+  template <typename T>
+  static void cfgSchemaHelper(std::string& schema, Optional<T>*, std::vector<std::string>& stack){
+    cfgContainerSchemaHelper(schema, "o", (T*)NULL, stack);
+  }
+
+  /// cfgSchemaHelper for all other types, which are written as text
+  template <typename T>
+  static typename std::enable_if<!std::is_base_of<Configurator,T>::value && !CfgIsBulkCopyable<T>::value,void>::type
+    cfgSchemaHelper(std::string& schema, T*, std::vector<std::string>& stack){
+      schema += 't';
   }
 
   /////////////////////////////////////////////////////////////////////////////
   // cfgCompareHelper(a, b)
   // returns 0 if same, >0 if different
 
-  /// cfgCompareHelper for Configurator
+  /// cfgCompareHelper for Configurator, b may be of any type
   static int cfgCompareHelper(Configurator& a, Configurator& b);
 
+  /// cfgCompareHelper for members of type T, a descendant of Configurator,
+  ///   so b is known to be of the same type
+  template <typename T>
+  static typename std::enable_if<std::is_base_of<Configurator,T>::value,int>::type
+    cfgCompareHelper(T& a, T& b){
+      return static_cast<Configurator&>(a).cfgCompareEntries(b);
+  }
+
   template <typename T1, typename T2>
   static int cfgCompareHelper(std::pair<T1,T2>& a, std::pair<T1,T2>& b){
-    return cfgCompareHelper(a.first, b.first) + cfgCompareHelper(a.second, b.second);
+    return cfgCompareHelper(a.first, b.first) || cfgCompareHelper(a.second, b.second);
   }
 
+  /// returns 1 at the first element that differs
   template <typename Container>
   static int cfgContainerCompareHelper(Container& a, Container& b){
-    int retVal = 0;
+    if(a.size()!=b.size()) return 1; // containers not same size
     typename Container::iterator i = a.begin();
     typename Container::iterator j = b.begin();
-    while(i!=a.end() && j!=b.end()){
-      retVal+=cfgCompareHelper(*i,*j);
-      i++; j++;
+    for(; i!=a.end(); i++, j++){
+      if(cfgCompareHelper(*i,*j)) return 1;
     }
-    if(i!=a.end() || j!=b.end()) return 1; // containers not same size
-
-    return retVal;
+    return 0;
   }
   
   /// cfgCompareHelper for any type with defined operator==
@@ -312,6 +1764,49 @@ protected:
     return cfgContainerCompareHelper(a,b);
   }
 
+  template <typename T>
+  static int cfgCompareHelper(std::deque<T>& a, std::deque<T>& b){
+    return cfgContainerCompareHelper(a,b);
+  }
+
+  template <typename T>
+  static int cfgCompareHelper(std::list<T>& a, std::list<T>& b){
+    return cfgContainerCompareHelper(a,b);
+  }
+
+  template <typename T, size_t N>
+  static int cfgCompareHelper(SmallVector<T,N>& a, SmallVector<T,N>& b){
+    return cfgContainerCompareHelper(a,b);
+  }
+
+  /// cfgCompareHelper for unordered_set, independent of order: each element
+  ///   of a is looked up in b
+  template <typename T, typename H, typename E>
+  static int cfgCompareHelper(std::unordered_set<T,H,E>& a, std::unordered_set<T,H,E>& b){
+    if(a.size()!=b.size()) return 1;
+    for(typename std::unordered_set<T,H,E>::iterator i=a.begin(); i!=a.end(); i++){
+      if(b.find(*i)==b.end()) return 1;
+    }
+    return 0;
+  }
+
+  /// cfgCompareHelper for unordered_map, independent of order: each key of a
+  ///   is looked up in b and the values compared
+  template <typename T1, typename T2, typename H, typename E>
+  static int cfgCompareHelper(std::unordered_map<T1,T2,H,E>& a, std::unordered_map<T1,T2,H,E>& b){
+    if(a.size()!=b.size()) return 1;
+    for(typename std::unordered_map<T1,T2,H,E>::iterator i=a.begin(); i!=a.end(); i++){
+      typename std::unordered_map<T1,T2,H,E>::iterator j = b.find(i->first);
+      if(j==b.end() || cfgCompareHelper(i->second, j->second)) return 1;
+    }
+    return 0;
+  }
+
+  template <typename T>
+  static int cfgCompareHelper(Lazy<T>& a, Lazy<T>& b){
+    return cfgCompareHelper(a.get(), b.get());
+  }
+
   template <typename T>
   static int cfgCompareHelper(Optional<T>& a, Optional<T>& b){
     if(!a.isSet() && !b.isSet()) return 0;  // both empty, so same
@@ -319,6 +1814,238 @@ protected:
     return cfgCompareHelper((T&)a,(T&)b);
   }
 
+  /////////////////////////////////////////////////////////////////////////////
+  // cfgHashHelper(seed, val)
+  // Used internally by hash()
+  // Combines the hash of val into seed.  Values that cfgCompareHelper finds
+  //   equal have equal hashes.
+
+  static void cfgHashCombine(size_t& seed, size_t h){
+    seed ^= h + (size_t)0x9e3779b97f4a7c15ULL + (seed<<6) + (seed>>2);
+  }
+
+  /// cfgHashHelper for numbers, bool and chars
+  template <typename T>
+  static typename std::enable_if<std::is_arithmetic<T>::value,void>::type
+    cfgHashHelper(size_t& seed, T& val){
+      typedef typename std::remove_cv<T>::type U;
+      // -0.0==0.0, so both must hash the same
+      cfgHashCombine(seed, val==T(0) ? 0 : std::hash<U>()(val));
+  }
+
+  /// cfgHashHelper for enums
+  template <typename T>
+  static typename std::enable_if<std::is_enum<T>::value,void>::type
+    cfgHashHelper(size_t& seed, T& val){
+      cfgHashCombine(seed, std::hash<long long>()((long long)val));
+  }
+
+  /// cfgHashHelper for string
+  static void cfgHashHelper(size_t& seed, std::string& str){
+    cfgHashCombine(seed, std::hash<std::string>()(str));
+  }
+
+  /// cfgHashHelper for descendants of Configurator
+  static void cfgHashHelper(size_t& seed, Configurator& cfg){
+    cfgHashCombine(seed, cfg.cfgHashEntries());
+  }
+
+  /// cfgHashHelper for std::pair
+  template <typename T1, typename T2>
+  static void cfgHashHelper(size_t& seed, std::pair<T1,T2>& pair){
+    cfgHashHelper(seed, remove_const(pair.first));
+    cfgHashHelper(seed, pair.second);
+  }
+
+  /// cfgHashHelper for anything with iterators, size then elements
+  template <typename Container>
+  static void cfgContainerHashHelper(size_t& seed, Container& c){
+    cfgHashCombine(seed, c.size());
+    for(typename Container::iterator i=c.begin(); i!=c.end(); i++)
+      cfgHashHelper(seed, remove_const(*i));
+  }
+
+  template <typename T>
+  static void cfgHashHelper(size_t& seed, std::vector<T>& vec){
+    cfgContainerHashHelper(seed, vec);
+  }
+
+  template <typename T, size_t N>
+  static void cfgHashHelper(size_t& seed, std::array<T,N>& arr){
+    cfgContainerHashHelper(seed, arr);
+  }
+
+  template <typename T>
+  static void cfgHashHelper(size_t& seed, std::set<T>& set){
+    cfgContainerHashHelper(seed, set);
+  }
+
+  template <typename T1, typename T2>
+  static void cfgHashHelper(size_t& seed, std::map<T1,T2>& map){
+    cfgContainerHashHelper(seed, map);
+  }
+
+  template <typename T>
+  static void cfgHashHelper(size_t& seed, std::deque<T>& deq){
+    cfgContainerHashHelper(seed, deq);
+  }
+
+  template <typename T>
+  static void cfgHashHelper(size_t& seed, std::list<T>& list){
+    cfgContainerHashHelper(seed, list);
+  }
+
+  template <typename T, size_t N>
+  static void cfgHashHelper(size_t& seed, SmallVector<T,N>& vec){
+    cfgContainerHashHelper(seed, vec);
+  }
+
+  /// hashes the elements of an unordered container independent of their
+  ///   order, by adding up the hash of each
+  template <typename Container>
+  static void cfgUnorderedHashHelper(size_t& seed, Container& c){
+    size_t sum = 0;
+    for(typename Container::iterator i=c.begin(); i!=c.end(); i++){
+      size_t h = 0;
+      cfgHashHelper(h, remove_const(*i));
+      sum += h;
+    }
+    cfgHashCombine(seed, c.size());
+    cfgHashCombine(seed, sum);
+  }
+
+  template <typename T, typename H, typename E>
+  static void cfgHashHelper(size_t& seed, std::unordered_set<T,H,E>& set){
+    cfgUnorderedHashHelper(seed, set);
+  }
+
+  template <typename T1, typename T2, typename H, typename E>
+  static void cfgHashHelper(size_t& seed, std::unordered_map<T1,T2,H,E>& map){
+    cfgUnorderedHashHelper(seed, map);
+  }
+
+  template <typename T>
+  static void cfgHashHelper(size_t& seed, Lazy<T>& lazy){
+    cfgHashHelper(seed, lazy.get());
+  }
+
+  /// cfgHashHelper for Optional<T>, unset hashes differently from any value
+  template <typename T>
+  static void cfgHashHelper(size_t& seed, Optional<T>& opt){
+    cfgHashCombine(seed, opt.isSet());
+    if(opt.isSet()) cfgHashHelper(seed, (T&)opt);
+  }
+
+  /// cfgHashHelper for all other types, hashes the text written by cfgWriteToStreamHelper
+  template <typename T>
+  static typename std::enable_if<!std::is_base_of<Configurator,T>::value && 
+    !std::is_arithmetic<T>::value && !std::is_enum<T>::value,void>::type
+    cfgHashHelper(size_t& seed, T& val){
+      CfgWriter text;
+      cfgWriteToStreamHelper(text, val, 0);
+      cfgHashHelper(seed, text.buffer());
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  // cfgVisitHelper(visitor, name, val)
+  // Used internally by visit()
+  // Passes val to the visitor, recursing into structs and containers.
+  //   Elements of containers have an empty name.
+
+  /// cfgVisitHelper for descendants of Configurator
+  template <typename Visitor, typename T>
+  static typename std::enable_if<std::is_base_of<Configurator,T>::value>::type
+    cfgVisitHelper(Visitor& visitor, const char* name, T& cfg){
+      visitor.beginStruct(name, cfg);
+      cfg.visit(visitor);
+      visitor.endStruct(name, cfg);
+  }
+
+  /// cfgVisitHelper for all other types, including keys of sets and maps,
+  ///   which are const
+  template <typename Visitor, typename T>
+  static typename std::enable_if<!std::is_base_of<Configurator,T>::value>::type
+    cfgVisitHelper(Visitor& visitor, const char* name, T& val){
+      visitor.value(name, val);
+  }
+
+  /// cfgVisitHelper for std::pair, a container of 2 elements
+  template <typename Visitor, typename T1, typename T2>
+  static void cfgVisitHelper(Visitor& visitor, const char* name, std::pair<T1,T2>& pair){
+    visitor.beginContainer(name, 2);
+    cfgVisitHelper(visitor, "", pair.first);
+    cfgVisitHelper(visitor, "", pair.second);
+    visitor.endContainer(name);
+  }
+
+  /// visits the elements of anything with iterators
+  template <typename Visitor, typename Container>
+  static void cfgContainerVisitHelper(Visitor& visitor, const char* name, Container& c){
+    visitor.beginContainer(name, c.size());
+    for(typename Container::iterator i=c.begin(); i!=c.end(); i++)
+      cfgVisitHelper(visitor, "", *i);
+    visitor.endContainer(name);
+  }
+
+  template <typename Visitor, typename T>
+  static void cfgVisitHelper(Visitor& visitor, const char* name, std::vector<T>& vec){
+    cfgContainerVisitHelper(visitor, name, vec);
+  }
+
+  template <typename Visitor, typename T, size_t N>
+  static void cfgVisitHelper(Visitor& visitor, const char* name, std::array<T,N>& arr){
+    cfgContainerVisitHelper(visitor, name, arr);
+  }
+
+  template <typename Visitor, typename T>
+  static void cfgVisitHelper(Visitor& visitor, const char* name, std::set<T>& set){
+    cfgContainerVisitHelper(visitor, name, set);
+  }
+
+  template <typename Visitor, typename T1, typename T2>
+  static void cfgVisitHelper(Visitor& visitor, const char* name, std::map<T1,T2>& map){
+    cfgContainerVisitHelper(visitor, name, map);
+  }
+
+  template <typename Visitor, typename T, typename H, typename E>
+  static void cfgVisitHelper(Visitor& visitor, const char* name, std::unordered_set<T,H,E>& set){
+    cfgContainerVisitHelper(visitor, name, set);
+  }
+
+  template <typename Visitor, typename T1, typename T2, typename H, typename E>
+  static void cfgVisitHelper(Visitor& visitor, const char* name, std::unordered_map<T1,T2,H,E>& map){
+    cfgContainerVisitHelper(visitor, name, map);
+  }
+
+  template <typename Visitor, typename T>
+  static void cfgVisitHelper(Visitor& visitor, const char* name, std::deque<T>& deq){
+    cfgContainerVisitHelper(visitor, name, deq);
+  }
+
+  template <typename Visitor, typename T>
+  static void cfgVisitHelper(Visitor& visitor, const char* name, std::list<T>& list){
+    cfgContainerVisitHelper(visitor, name, list);
+  }
+
+  template <typename Visitor, typename T, size_t N>
+  static void cfgVisitHelper(Visitor& visitor, const char* name, SmallVector<T,N>& vec){
+    cfgContainerVisitHelper(visitor, name, vec);
+  }
+
+  /// cfgVisitHelper for Lazy<T>, visited as T
+  template <typename Visitor, typename T>
+  static void cfgVisitHelper(Visitor& visitor, const char* name, Lazy<T>& lazy){
+    cfgVisitHelper(visitor, name, lazy.get());
+  }
+
+  /// cfgVisitHelper for Optional<T>, a container of 0 or 1 elements
+  template <typename Visitor, typename T>
+  static void cfgVisitHelper(Visitor& visitor, const char* name, Optional<T>& opt){
+    visitor.beginContainer(name, opt.isSet() ? 1 : 0);
+    if(opt.isSet()) cfgVisitHelper(visitor, "", (T&)opt);
+    visitor.endContainer(name);
+  }
+
   /// returns true if optional type and value is set
   template<typename T>
   static bool cfgIsSetOrNotOptional(Optional<T>& opt){
@@ -346,20 +2073,65 @@ protected:
     container.clear();
   }
 
-  // inserting into array by index
+  // reserving room for n elements, in containers that can
+  template<typename T>
+  static void reserve_helper(std::vector<T>& vec, size_t n){ vec.reserve(n); }
+  template<typename T, size_t N>
+  static void reserve_helper(SmallVector<T,N>& vec, size_t n){ vec.reserve(n); }
+  template<typename T, typename H, typename E>
+  static void reserve_helper(std::unordered_set<T,H,E>& set, size_t n){ set.reserve(n); }
+  template<typename T1, typename T2, typename H, typename E>
+  static void reserve_helper(std::unordered_map<T1,T2,H,E>& map, size_t n){ map.reserve(n); }
+  template<typename Container>
+  static void reserve_helper(Container& container, size_t n){}
+
+  // reserving room for the elements of the container at in.pos(), by
+  //   counting them first.  Only for containers that can reserve
+  template<typename T>
+  static void reserve_from_text(CfgReader& in, std::vector<T>& vec){ reserve_text_helper(in, vec); }
+  template<typename T, size_t N>
+  static void reserve_from_text(CfgReader& in, SmallVector<T,N>& vec){ reserve_text_helper(in, vec); }
+  template<typename T, typename H, typename E>
+  static void reserve_from_text(CfgReader& in, std::unordered_set<T,H,E>& set){ reserve_text_helper(in, set); }
+  template<typename T1, typename T2, typename H, typename E>
+  static void reserve_from_text(CfgReader& in, std::unordered_map<T1,T2,H,E>& map){ reserve_text_helper(in, map); }
+  template<typename Container>
+  static void reserve_from_text(CfgReader& in, Container& container){}
+
+  // items in the text per element: pairs, e.g. of maps, are 2 items
+  template<typename T>
+  struct CfgItemsPerElement{ static const size_t value = 1; };
+  template<typename T1, typename T2>
+  struct CfgItemsPerElement< std::pair<T1,T2> >{ static const size_t value = 2; };
+
+  template<typename Container>
+  static void reserve_text_helper(CfgReader& in, Container& container){
+    size_t items = cfgCountItems(in.pos(), in.end());
+    reserve_helper(container, items/CfgItemsPerElement<typename Container::value_type>::value);
+  }
+
+  // inserting into array by index, moving val
   template<typename T, size_t N>
   static void insert_helper(std::array<T,N>& arr, size_t i, T& val){
     if(i>=N) throw std::range_error("insert exceeds array size");
-    arr[i] = val;
+    arr[i] = std::move(val);
   }
 
-  // inserting into end of container (ignoring index, but should match anyway)
+  // inserting into end of container (ignoring index, but should match anyway),
+  //   moving val
   template<typename Container, typename T>
   static void insert_helper(Container& container, size_t i, T& val){
     assert(container.size()==i); 
-    container.insert(container.end(),val);
+    container.insert(container.end(),std::move(val));
   }
 
+  // type an element is parsed into before inserting it: the value_type,
+  //   except that map keys aren't const, so they can be moved too
+  template<typename T>
+  struct CfgParseType{ typedef T type; };
+  template<typename T1, typename T2>
+  struct CfgParseType< std::pair<const T1,T2> >{ typedef std::pair<T1,T2> type; };
+
 };
 
 //////////////////////////////////////////////////////////////////
@@ -368,100 +2140,158 @@ protected:
 // setFromString for vectors
 // Parses vector from stream of format: "[1 2 3 4 5]" (commas required for strings, optional for others)
 template <typename Container>
-void Configurator::cfgContainerSetFromStream(std::istream& is, Container& container, const std::string& subVar){
+void Configurator::cfgContainerSetFromStream(CfgReader& in, Container& container, const std::string& subVar){
   if(!subVar.empty()) { //subVar should be empty
-    is.setstate(std::ios::failbit); //set fail bit to trigger error handling
+    in.setFail(); //set fail to trigger error handling
     return;
   }
-  std::string line;
   clear_helper(container);
   
   // find next non-space
-  while(isspace(is.peek())) is.ignore();
+  in.skipSpaces();
   
   // make sure '['
-  char c = is.get();
-  if(c!='['){ // if c is not '[' set failbit in stream
-    is.setstate(std::ios::failbit); 
+  if(in.peek()!='['){ // if c is not '[' set fail
+    in.setFail();
     return;
   }
+  in.ignore();
+  reserve_from_text(in, container);
 
   // find next non-space
-  while(isspace(is.peek())) is.ignore();
+  in.skipSpaces();
 
   // parse each element
   size_t index=0;
-  while(is.good()){
+  while(!in.fail()){
     // check for each of vector
-    if(is.peek()==']'){
-      is.ignore();
+    if(in.peek()==']'){
+      in.ignore();
+      break;
+    }
+    if(in.eof()){ // no closing bracket
+      in.setFail();
       break;
     }
 
     // read element and add to vector
-    typename Container::value_type val;
-    cfgSetFromStream(is,val);
+    const char* elementStart = in.pos();
+    typename CfgParseType<typename Container::value_type>::type val{};
+    cfgSetFromStream(in,val);
+    if(in.pos()==elementStart) in.setFail(); // nothing parsed, e.g. stray '}'
     try{
-      if(is) insert_helper(container, index, val);
+      if(in) insert_helper(container, index, val);
     }catch(std::range_error&){
-      is.setstate(std::ios::failbit);  // exceeded container size
+      in.setFail();  // exceeded container size
       return;
     }
 
     // push to next element, removing comments
-    while(isspace(is.peek())||is.peek()==','||is.peek()=='#') {
-      std::string dumpStr;
-      if(is.peek()=='#') getline(is,dumpStr);
-      else is.ignore();
-    }
+    in.skipSeparators();
 
     index++;
   }
 }
 
+// Parses a vector on several threads.  A pre-scan finds the bounds of the
+// elements, then each element is parsed from its own reader into pre-sized
+// storage, so the result doesn't depend on the order the threads run in.
+// If any element doesn't parse, vec is left as is and the caller parses
+// serially, which reports the error the usual way.
+template <typename T>
+bool Configurator::cfgParallelSetFromStream(CfgReader& in, std::vector<T>& vec){
+  std::vector< std::pair<const char*,const char*> > elements;
+  const char* end;
+  if(!cfgScanElements(in, elements, end)) return false;
+  std::vector<T> result(elements.size());
+  if(!cfgParseElements(in, elements, [&result](size_t i, CfgReader& element){
+    cfgSetFromStream(element, result[i]);
+  })) return false;
+  vec.swap(result);
+  in.setPos(end);
+  return true;
+}
+
 // cfgWriteToStreamHelper for vectors
-// Prints container to stream in format: "[1,2,3,4,5]"
+// Prints container to writer in format: "[1,2,3,4,5]"
 template <typename Container>
-void Configurator::cfgContainerWriteToStreamHelper(std::ostream& stream, Container& c, int indent){
-  stream<<"[";
+void Configurator::cfgContainerWriteToStreamHelper(CfgWriter& out, Container& c, int indent){
+  out.put('[');
   for(typename Container::iterator i=c.begin(); i!=c.end(); i++){
-    if(i!=c.begin()) stream<<",";
-    cfgWriteToStreamHelper(stream,*i,indent);
+    if(i!=c.begin()) out.put(',');
+    cfgWriteToStreamHelper(out,*i,indent);
+    out.flushIfFull();
   }
-  stream<<"]";
+  out.put(']');
 }
 
 //////////////////////////////////////////////////////////////////
 // Macros to automatically generate the cfgMultiFunction method in
 // descendant classes.
 
-// automatically generates subclass constructor and begins cfgMultiFunction method
-#define CFG_HEADER(structName) \
-  structName() { cfgMultiFunction(CFG_INIT_ALL,NULL,NULL,NULL,NULL,0,NULL); } \
+// members generated by both CFG_HEADER and CFG_FIELDS: getStructName,
+// cfgCompareEntries, cfgHashEntries, cfgWriteEntries, cfgWriteBinaryEntries,
+// cfgReadBinaryEntries, cfgGetKeyTable, visit and cfgSelfType
+#define CFG_COMMON(structName) \
   std::string getStructName() { return #structName; } \
+  int cfgCompareEntries(Configurator& other){ \
+    CfgCompareOp op(&other); \
+    return cfgForEachEntry(op); \
+  } \
+  size_t cfgHashEntries(){ \
+    CfgHashOp op; \
+    cfgForEachEntry(op); \
+    return op.seed; \
+  } \
+  int cfgWriteEntries(codepi::CfgWriter& out, int indent){ \
+    CfgWriteOp op(this,out,indent); \
+    return cfgForEachEntry(op); \
+  } \
+  int cfgWriteBinaryEntries(codepi::CfgWriter& out){ \
+    CfgBinaryWriteOp op(out); \
+    return cfgForEachEntry(op); \
+  } \
+  int cfgReadBinaryEntries(codepi::CfgReader& in){ \
+    CfgBinaryReadOp op(this,in); \
+    return cfgForEachEntry(op); \
+  } \
+  const CfgKeyTable& cfgGetKeyTable() { \
+    static const CfgKeyTable table(cfgBuildKeyTable(this)); \
+    return table; \
+  } \
+  template <typename CfgVisitorType> void visit(CfgVisitorType& visitor){ \
+    CfgVisitOp<CfgVisitorType> op(visitor); \
+    cfgForEachEntry(op); \
+  } \
+  typedef structName cfgSelfType;
+
+// automatically generates subclass constructor, cfgMultiFunction, cfgInitEntries
+// and the members in CFG_COMMON,
+// and begins cfgForEachEntry method
+#define CFG_HEADER(structName) \
+  structName() { cfgInitEntries(); } \
   int cfgMultiFunction(MFType mfType, std::string* str, std::string* subVar, \
     std::istream* streamIn, std::ostream* streamOut,int indent,Configurator*other){ \
-    int retVal=0; \
-    structName* otherPtr; \
-    if(mfType==CFG_COMPARE) {otherPtr = dynamic_cast<structName*>(other); \
-      if(!otherPtr) return 1; /*dynamic cast failed, types different*/ }
-
-// continues cfgMultiFunction method, called for each member variable in struct 
+    if(mfType==CFG_COMPARE) \
+      return dynamic_cast<structName*>(other) ? cfgCompareEntries(*other) \
+        : 1; /*dynamic cast failed, types different*/ \
+    if(mfType==CFG_INIT_ALL) return cfgInitEntries(); \
+    CfgMultiFunctionOp op(this,mfType,str,subVar,streamIn,streamOut,indent,other); \
+    return cfgForEachEntry(op); \
+  } \
+  int cfgInitEntries(){ \
+    CfgInitOp op; \
+    return cfgForEachEntry(op); \
+  } \
+  CFG_COMMON(structName) \
+  template <typename CfgOp> int cfgForEachEntry(CfgOp& cfgOp){ \
+    int retVal=0;
+
+// continues cfgForEachEntry method, called for each member variable in struct 
 #define CFG_ENTRY_DEF(varName, defaultVal) \
-  if(mfType==CFG_INIT_ALL) { \
+  if(cfgOp.cfgInitDefaults()) { \
     if(cfgIsSetOrNotOptional(varName)) {varName = defaultVal;retVal++;} \
-    } else if(mfType==CFG_SET && #varName==*str) { cfgSetFromStream(*streamIn,varName,*subVar);retVal++;} \
-  else if(mfType==CFG_WRITE_ALL) { \
-    if(cfgIsSetOrNotOptional(varName)) { \
-      *streamOut<<cfgIndentBy(indent)<<#varName<<"="; \
-      cfgWriteToStreamHelper(*streamOut,varName,indent); \
-      *streamOut<<std::endl;retVal++; \
-      if(streamOut->fail()) \
-        throwError("Configurator ("+getStructName()+") error, can't write variable: "+#varName); \
-    } \
-  } else if(mfType==CFG_COMPARE) { \
-    retVal+=cfgCompareHelper(this->varName,otherPtr->varName); \
-  }
+  } else retVal+=cfgOp(#varName, this, &cfgSelfType::varName);
 
 // alternative to CFG_ENTRY_DEF used when default defaultVal is sufficient
 #define CFG_ENTRY(varName) CFG_ENTRY_DEF(varName, cfgGetDefaultVal(varName))
@@ -478,13 +2308,89 @@ void Configurator::cfgContainerWriteToStreamHelper(std::ostream& stream, Contain
 #define CFG_MULTIENTRY9(v1,v2,v3,v4,v5,v6,v7,v8,v9)      CFG_ENTRY(v1) CFG_MULTIENTRY8(v2,v3,v4,v5,v6,v7,v8,v9)
 #define CFG_MULTIENTRY10(v1,v2,v3,v4,v5,v6,v7,v8,v9,v10) CFG_ENTRY(v1) CFG_MULTIENTRY9(v2,v3,v4,v5,v6,v7,v8,v9,v10)
 
-// calls cfgMultiFunction method of parent
+// calls cfgForEachEntry method of parent
 // allows for inheritance
 #define CFG_PARENT(parentName) \
-  int rc=parentName::cfgMultiFunction(mfType,str,subVar,streamIn,streamOut,indent,other); \
-  retVal+=rc;
+  retVal+=parentName::cfgForEachEntry(cfgOp);
 
-// closes out cfgMultiFunction method
+// closes out cfgForEachEntry method
 #define CFG_TAIL return retVal; }
 
+// Alternative to CFG_HEADER ... CFG_TAIL that declares the entries as a list
+//   of fields, e.g.
+//     CFG_FIELDS(MyConfig, CFG_FIELD_DEF(port, 80), CFG_FIELD(host))
+//   Each operation (setting defaults, writing, reading, comparing, hashing)
+//   is a loop over the list, unrolled at compile time, so it is a sequence of
+//   direct calls for the entries with no other per entry code.
+//   The list is returned by the static method cfgFields().
+#define CFG_FIELDS(structName, ...) CFG_FIELDS_PARENT(structName, CfgNoParent, __VA_ARGS__)
+
+// CFG_FIELDS for a struct derived from another Configurator descendant,
+//   whose entries follow those in the list, like CFG_PARENT at the end
+#define CFG_FIELDS_PARENT(structName, parentName, ...) \
+  structName() { cfgInitEntries(); } \
+  CFG_COMMON(structName) \
+  static auto cfgFields() -> decltype(std::make_tuple(__VA_ARGS__)) { \
+    return std::make_tuple(__VA_ARGS__); \
+  } \
+  int cfgMultiFunction(MFType mfType, std::string* str, std::string* subVar, \
+    std::istream* streamIn, std::ostream* streamOut,int indent,Configurator*other){ \
+    if(mfType==CFG_COMPARE) \
+      return dynamic_cast<structName*>(other) ? cfgCompareEntries(*other) \
+        : 1; /*dynamic cast failed, types different*/ \
+    if(mfType==CFG_INIT_ALL) return cfgInitEntries(); \
+    CfgMultiFunctionOp op(this,mfType,str,subVar,streamIn,streamOut,indent,other); \
+    return cfgForEachEntry(op); \
+  } \
+  int cfgInitEntries(){ \
+    typedef decltype(cfgFields()) cfgFieldList; \
+    int retVal = CfgFieldLoop<0,std::tuple_size<cfgFieldList>::value>::init(this, cfgFields()); \
+    return retVal + parentName::cfgInitEntries(); \
+  } \
+  template <typename CfgOp> int cfgForEachEntry(CfgOp& cfgOp){ \
+    if(cfgOp.cfgInitDefaults()) return cfgInitEntries(); \
+    typedef decltype(cfgFields()) cfgFieldList; \
+    int retVal = CfgFieldLoop<0,std::tuple_size<cfgFieldList>::value>::forEach(this, cfgFields(), cfgOp); \
+    return retVal + parentName::cfgForEachEntry(cfgOp); \
+  }
+
+// entry of CFG_FIELDS, with the default value of its type or the given one
+#define CFG_FIELD(varName) cfgField(#varName, &cfgSelfType::varName)
+#define CFG_FIELD_DEF(varName, defaultVal) cfgField(#varName, &cfgSelfType::varName, defaultVal)
+
+/// Base for visitors passed to visit(), which calls
+///     value(name, member)              for each entry that isn't a struct or container
+///     beginStruct(name, member), visit of member, endStruct(name, member)
+///                                      for each nested struct
+///     beginContainer(name, size), each element, endContainer(name)
+///                                      for vector, array, set, map, pair and
+///                                      Optional (0 or 1 elements)
+///   in declaration order, including the entries of parents.  Elements have
+///   an empty name, and keys of sets and maps are const.  Members are passed
+///   by reference, so a visitor may modify them (except keys).
+///   The calls are resolved at compile time, so a visitor overloads the ones
+///   it needs (with "using CfgVisitor::value;" to keep the others) and the
+///   rest do nothing.
+struct CfgVisitor{
+  template <typename T> void value(const char* name, T& val) {}
+  template <typename T> void beginStruct(const char* name, T& cfg) {}
+  template <typename T> void endStruct(const char* name, T& cfg) {}
+  void beginContainer(const char* name, size_t size) {}
+  void endContainer(const char* name) {}
+};
+
+/// hash and equality functors, for Configurator descendants as keys of
+///   unordered containers, e.g. std::unordered_set<MyConfig,CfgHash,CfgEqual>
+struct CfgHash{
+  size_t operator()(const Configurator& cfg) const {
+    return const_cast<Configurator&>(cfg).hash();
+  }
+};
+
+struct CfgEqual{
+  bool operator()(const Configurator& a, const Configurator& b) const {
+    return const_cast<Configurator&>(a)==const_cast<Configurator&>(b);
+  }
+};
+
 } //end namespace codepi
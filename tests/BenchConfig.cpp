@@ -0,0 +1,411 @@
+// Benchmark for Configurator parsing and writing throughput.
+// Builds a large config in memory, then times each operation.
+
+#include "../Configurator/configurator.h"
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+using namespace codepi;
+
+struct BenchItem : public Configurator {
+  int id;
+  string name;
+  vector<string> tags;
+  double weight;
+  bool enabled;
+
+  CFG_HEADER(BenchItem)
+  CFG_ENTRY(id)
+  CFG_ENTRY(name)
+  CFG_ENTRY(tags)
+  CFG_ENTRY(weight)
+  CFG_ENTRY(enabled)
+  CFG_TAIL
+};
+
+struct BenchConfig : public Configurator {
+  vector<BenchItem> items;
+  vector<string> strings;
+  vector<int> ints;
+  vector<float> floats;
+  map<string, int> lookup;
+
+  CFG_HEADER(BenchConfig)
+  CFG_ENTRY(items)
+  CFG_ENTRY(strings)
+  CFG_ENTRY(ints)
+  CFG_ENTRY(floats)
+  CFG_ENTRY(lookup)
+  CFG_TAIL
+};
+
+// same struct, with the large entries parsed on first access
+struct BenchLazyConfig : public Configurator {
+  Lazy< vector<BenchItem> > items;
+  Lazy< vector<string> > strings;
+  vector<int> ints;
+  Lazy< vector<float> > floats;
+  Lazy< map<string, int> > lookup;
+
+  CFG_HEADER(BenchLazyConfig)
+  CFG_ENTRY(items)
+  CFG_ENTRY(strings)
+  CFG_ENTRY(ints)
+  CFG_ENTRY(floats)
+  CFG_ENTRY(lookup)
+  CFG_TAIL
+};
+
+// same structs, declared with CFG_FIELDS
+struct BenchFieldsItem : public Configurator {
+  int id;
+  string name;
+  vector<string> tags;
+  double weight;
+  bool enabled;
+
+  CFG_FIELDS(BenchFieldsItem,
+    CFG_FIELD(id),
+    CFG_FIELD(name),
+    CFG_FIELD(tags),
+    CFG_FIELD(weight),
+    CFG_FIELD(enabled))
+};
+
+struct BenchFieldsConfig : public Configurator {
+  vector<BenchFieldsItem> items;
+  vector<string> strings;
+  vector<int> ints;
+  vector<float> floats;
+  map<string, int> lookup;
+
+  CFG_FIELDS(BenchFieldsConfig,
+    CFG_FIELD(items),
+    CFG_FIELD(strings),
+    CFG_FIELD(ints),
+    CFG_FIELD(floats),
+    CFG_FIELD(lookup))
+};
+
+// Number that is parsed and written with operator>> and operator<<,
+// for comparing against the dedicated number parsing
+template <typename T>
+struct StreamNum {
+  T val;
+  bool operator==(const StreamNum& o) const { return val==o.val; }
+};
+template <typename T> istream& operator>>(istream& is, StreamNum<T>& n) { return is>>n.val; }
+template <typename T> ostream& operator<<(ostream& os, const StreamNum<T>& n) { return os<<n.val; }
+
+struct BenchNumbers : public Configurator {
+  vector<int> ints;
+  vector<float> floats;
+  vector<double> doubles;
+
+  CFG_HEADER(BenchNumbers)
+  CFG_ENTRY(ints)
+  CFG_ENTRY(floats)
+  CFG_ENTRY(doubles)
+  CFG_TAIL
+};
+
+struct BenchStreamNumbers : public Configurator {
+  vector< StreamNum<int> > ints;
+  vector< StreamNum<float> > floats;
+  vector< StreamNum<double> > doubles;
+
+  CFG_HEADER(BenchStreamNumbers)
+  CFG_ENTRY(ints)
+  CFG_ENTRY(floats)
+  CFG_ENTRY(doubles)
+  CFG_TAIL
+};
+
+// one large vector and one large map
+struct BenchLargeVector : public Configurator {
+  vector<int> ints;
+
+  CFG_HEADER(BenchLargeVector)
+  CFG_ENTRY(ints)
+  CFG_TAIL
+};
+
+struct BenchLargeMap : public Configurator {
+  map<string,int> lookup;
+
+  CFG_HEADER(BenchLargeMap)
+  CFG_ENTRY(lookup)
+  CFG_TAIL
+};
+
+// struct of Optional fields, a few of them set
+struct BenchOptional : public Configurator {
+  Optional<int> a, b, c, d;
+  Optional<double> e, f, g, h;
+  Optional<bool> i, j;
+
+  CFG_HEADER(BenchOptional)
+  CFG_ENTRY(a)
+  CFG_ENTRY(b)
+  CFG_ENTRY(c)
+  CFG_ENTRY(d)
+  CFG_ENTRY(e)
+  CFG_ENTRY(f)
+  CFG_ENTRY(g)
+  CFG_ENTRY(h)
+  CFG_ENTRY(i)
+  CFG_ENTRY(j)
+  CFG_TAIL
+};
+
+struct BenchOptionals : public Configurator {
+  vector<BenchOptional> opts;
+
+  CFG_HEADER(BenchOptionals)
+  CFG_ENTRY(opts)
+  CFG_TAIL
+};
+
+// counts heap allocations, for the allocations made by parsing
+static atomic<unsigned long long> gAllocations(0);
+
+// not inlined, so the compiler doesn't pair operator new with free
+#ifdef __GNUC__
+__attribute__((noinline))
+#endif
+static void freeAllocation(void* p) { free(p); }
+
+void* operator new(size_t size){
+  gAllocations++;
+  void* p = malloc(size ? size : 1);
+  if(!p) throw bad_alloc();
+  return p;
+}
+void operator delete(void* p) noexcept { freeAllocation(p); }
+void operator delete(void* p, size_t) noexcept { freeAllocation(p); }
+
+// prints the number of allocations made by func, per element of the config
+static void countAllocations(const char* name, size_t elements, const function<void()>& func){
+  unsigned long long before = gAllocations;
+  func();
+  unsigned long long count = gAllocations-before;
+  printf("%-26s %9llu allocs %6.2f per item\n", name, count, (double)count/elements);
+}
+
+// runs func reps times, prints best time and throughput for size bytes
+static void bench(const char* name, size_t size, int reps, const function<void()>& func){
+  double best = 1e30;
+  for(int i=0; i<reps; i++){
+    auto start = chrono::steady_clock::now();
+    func();
+    double secs = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    if(secs<best) best = secs;
+  }
+  printf("%-26s %9.2f ms %9.1f MB/s\n", name, best*1e3, size/best/1e6);
+}
+
+int main(int argc, char** argv){
+  int n = argc>1 ? atoi(argv[1]) : 20000;
+
+  BenchConfig cfg;
+  for(int i=0; i<n; i++){
+    BenchItem item;
+    item.id = i;
+    item.name = "item number " + to_string(i);
+    item.tags = { "alpha", "beta, gamma", "tag " + to_string(i%100) };
+    item.weight = i * 0.25;
+    item.enabled = i%2;
+    cfg.items.push_back(item);
+    cfg.strings.push_back("a somewhat longer string value " + to_string(i));
+    for(int j=0; j<10; j++){
+      cfg.ints.push_back(i*10+j);
+      cfg.floats.push_back((i*10+j)*0.5f);
+    }
+    cfg.lookup["key" + to_string(i)] = i;
+  }
+
+  string str = cfg.toString();
+  printf("config size: %.1f MB\n", str.size()/1e6);
+
+  bench("toString", str.size(), 3, [&]{ cfg.toString(); });
+  bench("readString", str.size(), 3, [&]{ BenchConfig c; c.readString(str); });
+  bench("readStream", str.size(), 3, [&]{ BenchConfig c; istringstream ss(str); c.readStream(ss); });
+  countAllocations("readString", n, [&]{ BenchConfig c; c.readString(str); });
+  // items is parsed on several threads, the rest serially
+  Configurator::setParseThreads(0);
+  bench("readString parallel", str.size(), 3, [&]{ BenchConfig c; c.readString(str); });
+  BenchConfig checkParallel;
+  checkParallel.readString(str);
+  Configurator::setParseThreads(1);
+
+  string bin;
+  cfg.writeToBinary(bin);
+  printf("binary size: %.1f MB\n", bin.size()/1e6);
+  bench("writeToBinary", bin.size(), 3, [&]{ cfg.writeToBinary(bin); });
+  bench("readBinary", bin.size(), 3, [&]{ BenchConfig c; c.readBinary(bin); });
+  string tagged;
+  cfg.writeToTaggedBinary(tagged);
+  printf("tagged binary size: %.1f MB\n", tagged.size()/1e6);
+  bench("writeToTaggedBinary", tagged.size(), 3, [&]{ cfg.writeToTaggedBinary(tagged); });
+  bench("readTaggedBinary", tagged.size(), 3, [&]{ BenchConfig c; c.readTaggedBinary(tagged); });
+
+  // equality and hash of the nested vector<BenchItem>
+  BenchConfig same = cfg, lastDiffers = cfg, firstDiffers = cfg;
+  lastDiffers.items.back().weight += 1;
+  firstDiffers.items.front().weight += 1;
+  volatile size_t result = 0;
+  bench("operator== equal", str.size(), 3, [&]{ result += cfg==same; });
+  bench("operator== last differs", str.size(), 3, [&]{ result += cfg==lastDiffers; });
+  bench("operator== first differs", str.size(), 3, [&]{ result += cfg==firstDiffers; });
+  bench("hash", str.size(), 3, [&]{ result += cfg.hash(); });
+
+  // Lazy entries, only ints is parsed unless the others are accessed
+  bench("readString lazy", str.size(), 3, [&]{ BenchLazyConfig c; c.readString(str); });
+  bench("readString lazy, access all", str.size(), 3, [&]{
+    BenchLazyConfig c;
+    c.readString(str);
+    result += c.items->size() + c.strings->size() + c.floats->size() + c.lookup->size();
+  });
+
+  // CFG_FIELDS instead of CFG_HEADER ... CFG_TAIL
+  BenchFieldsConfig fieldsCfg, fieldsSame;
+  fieldsCfg.readString(str);
+  fieldsSame.readString(str);
+  bench("construct items", str.size(), 3, [&]{ vector<BenchItem> v(n*10); });
+  bench("construct items CFG_FIELDS", str.size(), 3, [&]{ vector<BenchFieldsItem> v(n*10); });
+  bench("readString CFG_FIELDS", str.size(), 3, [&]{ BenchFieldsConfig c; c.readString(str); });
+  bench("toString CFG_FIELDS", str.size(), 3, [&]{ fieldsCfg.toString(); });
+  bench("readBinary CFG_FIELDS", bin.size(), 3, [&]{ BenchFieldsConfig c; c.readBinary(bin); });
+  bench("operator== CFG_FIELDS", str.size(), 3, [&]{ result += fieldsCfg==fieldsSame; });
+
+  bench("writeToFile", str.size(), 3, [&]{ cfg.writeToFile("bench.txt"); });
+  bench("readFile", str.size(), 3, [&]{ BenchConfig c; c.readFile("bench.txt"); });
+  remove("bench.txt");
+
+  // a small fragment included many times, read from disk each time or from the include cache
+  ofstream("bench_fragment.txt") << "# shared settings\nstrings=[a, b, c]\nints=[1, 2, 3]\nlookup=[x, 1, y, 2]\n";
+  string includes;
+  for(int i=0; i<1000; i++) includes += "include=bench_fragment.txt\n";
+  bench("readString 1000 includes", includes.size(), 3, [&]{ BenchConfig c; c.readString(includes); });
+  Configurator::setIncludeCache(true);
+  // files modified in the last seconds are checked by contents, wait until it's older
+  this_thread::sleep_for(chrono::seconds(3));
+  bench("same, include cache", includes.size(), 3, [&]{ BenchConfig c; c.readString(includes); });
+  unsigned long long hits, misses;
+  Configurator::getIncludeCacheStats(hits, misses);
+  printf("include cache: %llu hits, %llu misses\n", hits, misses);
+  Configurator::setIncludeCache(false);
+  Configurator::clearIncludeCache();
+  remove("bench_fragment.txt");
+
+  // numeric arrays, dedicated parsing vs operator>>
+  BenchNumbers nums;
+  for(int i=0; i<n*50; i++){
+    nums.ints.push_back(i*37-n);
+    nums.floats.push_back(i*0.37f);
+    nums.doubles.push_back(i/7.0);
+  }
+  string numStr = nums.toString();
+  printf("numbers size: %.1f MB\n", numStr.size()/1e6);
+  BenchStreamNumbers streamNums;
+  streamNums.readString(numStr);
+  bench("toString numbers", numStr.size(), 3, [&]{ nums.toString(); });
+  bench("toString operator<<", numStr.size(), 3, [&]{ streamNums.toString(); });
+  bench("readString numbers", numStr.size(), 3, [&]{ BenchNumbers c; c.readString(numStr); });
+  countAllocations("readString numbers", n, [&]{ BenchNumbers c; c.readString(numStr); });
+  string numBin;
+  nums.writeToBinary(numBin);
+  bench("writeToBinary numbers", numBin.size(), 3, [&]{ nums.writeToBinary(numBin); });
+  bench("readBinary numbers", numBin.size(), 3, [&]{ BenchNumbers c; c.readBinary(numBin); });
+  bench("readString operator>>", numStr.size(), 3, [&]{ BenchStreamNumbers c; c.readString(numStr); });
+
+  // 10M element vector and 1M entry map, at the default n
+  BenchLargeVector largeVec;
+  for(int i=0; i<n*500; i++) largeVec.ints.push_back(i*7-n);
+  string largeVecStr = largeVec.toString();
+  BenchLargeMap largeMap;
+  for(int i=0; i<n*50; i++) largeMap.lookup["key" + to_string(i)] = i;
+  string largeMapStr = largeMap.toString();
+  printf("large vector size: %.1f MB, large map size: %.1f MB\n", largeVecStr.size()/1e6, largeMapStr.size()/1e6);
+  bench("readString large vector", largeVecStr.size(), 3, [&]{ BenchLargeVector c; c.readString(largeVecStr); });
+  bench("readString large map", largeMapStr.size(), 3, [&]{ BenchLargeMap c; c.readString(largeMapStr); });
+  countAllocations("readString large vector", n*500, [&]{ BenchLargeVector c; c.readString(largeVecStr); });
+  countAllocations("readString large map", n*50, [&]{ BenchLargeMap c; c.readString(largeMapStr); });
+
+  // structs of Optional fields, copied and parsed
+  BenchOptionals opts;
+  opts.opts.resize(n);
+  for(int i=0; i<n; i++){
+    BenchOptional& o = opts.opts[i];
+    o.a = i;
+    o.c = i*3;
+    o.e = i*0.5;
+    o.h = i/7.0;
+    if(i%2) o.i = true;
+  }
+  string optStr = opts.toString();
+  printf("optionals size: %.1f MB\n", optStr.size()/1e6);
+  bench("copy optionals", optStr.size(), 3, [&]{ BenchOptionals c = opts; });
+  bench("readString optionals", optStr.size(), 3, [&]{ BenchOptionals c; c.readString(optStr); });
+  countAllocations("copy optionals", n, [&]{ BenchOptionals c = opts; });
+  countAllocations("readString optionals", n, [&]{ BenchOptionals c; c.readString(optStr); });
+
+  BenchConfig check;
+  check.readString(str);
+  if(check!=cfg) {
+    printf("Error: parsed config differs\n");
+    return -1;
+  }
+  if(cfg.hash()!=same.hash() || cfg.hash()==lastDiffers.hash()) {
+    printf("Error: hash inconsistent with operator==\n");
+    return -1;
+  }
+  if(checkParallel!=cfg) {
+    printf("Error: parallel parsed config differs\n");
+    return -1;
+  }
+  if(fieldsCfg.toString()!=str) {
+    printf("Error: CFG_FIELDS config differs\n");
+    return -1;
+  }
+  BenchLargeVector checkLargeVec;
+  checkLargeVec.readString(largeVecStr);
+  BenchLargeMap checkLargeMap;
+  checkLargeMap.readString(largeMapStr);
+  if(checkLargeVec!=largeVec || checkLargeMap!=largeMap) {
+    printf("Error: large container config differs\n");
+    return -1;
+  }
+  BenchOptionals checkOpts;
+  checkOpts.readString(optStr);
+  if(checkOpts!=opts) {
+    printf("Error: optionals config differs\n");
+    return -1;
+  }
+  BenchLazyConfig checkLazy;
+  checkLazy.readString(str);
+  if(checkLazy.toString()!=str) {
+    printf("Error: lazy config differs\n");
+    return -1;
+  }
+  BenchConfig checkBin;
+  checkBin.readBinary(bin);
+  if(checkBin!=cfg) {
+    printf("Error: binary config differs\n");
+    return -1;
+  }
+  BenchConfig checkTagged;
+  checkTagged.readTaggedBinary(tagged);
+  if(checkTagged!=cfg) {
+    printf("Error: tagged binary config differs\n");
+    return -1;
+  }
+  return 0;
+}
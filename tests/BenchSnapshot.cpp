@@ -0,0 +1,90 @@
+// Benchmark for concurrent reads of a config that is being updated.
+// Compares ConfigSnapshot with a mutex and with atomic shared_ptr access,
+// for increasing numbers of reader threads.
+
+#include "../Configurator/ConfigSnapshot.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+using namespace codepi;
+
+struct SnapConfig : public Configurator {
+  int port;
+  string host;
+  vector<int> limits;
+
+  CFG_HEADER(SnapConfig)
+  CFG_ENTRY_DEF(port, 80)
+  CFG_ENTRY_DEF(host, "localhost")
+  CFG_ENTRY(limits)
+  CFG_TAIL
+};
+
+// config behind a mutex
+struct MutexHolder {
+  mutex m;
+  shared_ptr<const SnapConfig> cfg = make_shared<SnapConfig>();
+  int read() { lock_guard<mutex> lock(m); return cfg->port; }
+  void publish(const shared_ptr<const SnapConfig>& next) { lock_guard<mutex> lock(m); cfg = next; }
+};
+
+// config behind std::atomic_load/atomic_store of a shared_ptr
+struct AtomicHolder {
+  shared_ptr<const SnapConfig> cfg = make_shared<SnapConfig>();
+  int read() { return atomic_load(&cfg)->port; }
+  void publish(const shared_ptr<const SnapConfig>& next) { atomic_store(&cfg, next); }
+};
+
+struct SnapshotHolder {
+  ConfigSnapshot<SnapConfig> cfg;
+  int read() { return cfg.read()->port; }
+  void publish(const shared_ptr<const SnapConfig>& next) { cfg.publish(next); }
+};
+
+// reads from nThreads threads for ms while one thread publishes every
+// millisecond, returns millions of reads per second
+template <typename Holder>
+static double bench(int nThreads, int ms){
+  Holder holder;
+  atomic<bool> stop(false);
+  atomic<long long> total(0);
+  vector<thread> threads;
+  for(int i=0; i<nThreads; i++){
+    threads.push_back(thread([&]{
+      long long n = 0, sum = 0;
+      while(!stop){
+        for(int j=0; j<100; j++) sum += holder.read();
+        n += 100;
+      }
+      total += n + (sum==-1); // use sum
+    }));
+  }
+  thread writer([&]{
+    for(int port=1; !stop; port++){
+      shared_ptr<SnapConfig> next = make_shared<SnapConfig>();
+      next->port = port;
+      holder.publish(next);
+      this_thread::sleep_for(chrono::milliseconds(1));
+    }
+  });
+  this_thread::sleep_for(chrono::milliseconds(ms));
+  stop = true;
+  for(size_t i=0; i<threads.size(); i++) threads[i].join();
+  writer.join();
+  return total/(ms*1e3);
+}
+
+int main(int argc, char** argv){
+  int maxThreads = argc>1 ? atoi(argv[1]) : max(4u, thread::hardware_concurrency());
+  int ms = 500;
+  printf("%-8s %14s %14s %14s\n", "threads", "mutex", "atomic_load", "ConfigSnapshot");
+  for(int n=1; n<=maxThreads; n*=2){
+    double m = bench<MutexHolder>(n, ms);
+    double a = bench<AtomicHolder>(n, ms);
+    double s = bench<SnapshotHolder>(n, ms);
+    printf("%-8d %9.1f M/s %9.1f M/s %9.1f M/s\n", n, m, a, s);
+  }
+  return 0;
+}
@@ -0,0 +1,209 @@
+// Tests for the tagged binary format: reading data written by an older or
+// newer version of a struct
+
+#include "TestConfig.h"
+#include <stdio.h>
+
+using namespace std;
+using namespace codepi;
+
+bool g_all_pass = true;
+
+const char* pf(bool test){
+  if(test==true) return "pass";
+  else {
+      g_all_pass = false;
+      return "fail";
+  }
+}
+
+namespace v1 {
+  struct Item : public Configurator {
+    int id;
+    string name;
+
+    CFG_HEADER(Item)
+    CFG_ENTRY(id)
+    CFG_ENTRY(name)
+    CFG_TAIL
+  };
+
+  struct Settings : public Configurator {
+    int port;
+    string host;
+    vector<Item> items;
+    double timeout;
+
+    CFG_HEADER(Settings)
+    CFG_ENTRY_DEF(port, 80)
+    CFG_ENTRY(host)
+    CFG_ENTRY(items)
+    CFG_ENTRY_DEF(timeout, 1.5)
+    CFG_TAIL
+  };
+}
+
+// version 2: timeout removed, retries and Item::tags added, entries reordered
+namespace v2 {
+  struct Item : public Configurator {
+    vector<string> tags;
+    string name;
+    int id;
+
+    CFG_HEADER(Item)
+    CFG_ENTRY(tags)
+    CFG_ENTRY(name)
+    CFG_ENTRY(id)
+    CFG_TAIL
+  };
+
+  struct Settings : public Configurator {
+    string host;
+    int port;
+    int retries;
+    vector<Item> items;
+
+    CFG_HEADER(Settings)
+    CFG_ENTRY(host)
+    CFG_ENTRY_DEF(port, 80)
+    CFG_ENTRY_DEF(retries, 3)
+    CFG_ENTRY(items)
+    CFG_TAIL
+  };
+}
+
+// v1::Settings that records errors instead of throwing
+struct LenientSettings : public v1::Settings {
+  vector<string> errors;
+  void throwError(string error){ errors.push_back(error); }
+};
+
+// same name as v1::Settings, but port changed type
+namespace v3 {
+  struct Settings : public Configurator {
+    string port;
+
+    CFG_HEADER(Settings)
+    CFG_ENTRY(port)
+    CFG_TAIL
+  };
+}
+
+// entry names whose field ids collide
+struct SameIds : public Configurator {
+  int costarring;
+  int liquid;
+
+  CFG_HEADER(SameIds)
+  CFG_ENTRY(costarring)
+  CFG_ENTRY(liquid)
+  CFG_TAIL
+};
+
+int main(){
+  try{
+    // same struct, with nested structs, containers and optionals
+    TestConfig tc;
+    tc.readFile("file.txt");
+    tc.opt1 = 1;
+    tc.optvec = vector<int>{ 1, 2 };
+    string bin;
+    tc.writeToTaggedBinary(bin);
+    TestConfig tc2;
+    tc2.opt2 = 5; // not in the data, so reset to unset
+    bool sameSchema = tc2.readTaggedBinary(bin);
+    printf("same struct round trip:\t\t%s\n", pf(sameSchema && tc==tc2));
+
+    string name;
+    unsigned long long hash = 0;
+    bool isTagged = Configurator::readTaggedBinaryHeader(bin.data(), bin.size(), name, hash);
+    printf("header:\t\t\t\t%s\n", pf(isTagged && name=="TestConfig" && hash==tc.getSchemaHash()));
+
+    // old writer, new reader
+    v1::Settings s1;
+    s1.port = 8080;
+    s1.host = "example.com";
+    s1.items.resize(2);
+    s1.items[0].id = 1;
+    s1.items[0].name = "first";
+    s1.items[1].id = 2;
+    s1.items[1].name = "second";
+    s1.timeout = 2.5;
+    s1.writeToTaggedBinary(bin);
+
+    v2::Settings s2;
+    s2.retries = 10;
+    sameSchema = s2.readTaggedBinary(bin);
+    printf("schema hash differs:\t\t%s\n", pf(!sameSchema && s1.getSchemaHash()!=s2.getSchemaHash()));
+    printf("old to new, known entries:\t%s\n", pf(s2.port==8080 && s2.host=="example.com" &&
+      s2.items.size()==2 && s2.items[1].id==2 && s2.items[1].name=="second"));
+    printf("old to new, missing entries:\t%s\n", pf(s2.retries==3 && s2.items[0].tags.empty()));
+
+    // new writer, old reader
+    s2.items[0].tags = { "a", "b" };
+    s2.retries = 7;
+    s2.writeToTaggedBinary(bin);
+    v1::Settings s1b;
+    s1b.timeout = 9;
+    s1b.readTaggedBinary(bin);
+    printf("new to old:\t\t\t%s\n", pf(s1b.port==8080 && s1b.items.size()==2 &&
+      s1b.items[0].name=="first" && s1b.timeout==1.5));
+
+    // incompatible changes are errors
+    bool caught = false;
+    try{ tc.readTaggedBinary(bin); }catch(runtime_error&){ caught = true; }
+    printf("different struct name throws:\t%s\n", pf(caught));
+
+    caught = false;
+    v3::Settings s3;
+    try{ s3.readTaggedBinary(bin); }catch(runtime_error&){ caught = true; }
+    printf("different entry type throws:\t%s\n", pf(caught));
+
+    caught = false;
+    try{ s1b.readTaggedBinary(bin.data(), bin.size()-1); }catch(runtime_error&){ caught = true; }
+    printf("truncated data throws:\t\t%s\n", pf(caught));
+
+    // deltas: a record cut off in its path is an error, not applied to
+    //   the previous record's entry
+    v1::Settings base, changed;
+    changed.port = 5;
+    string delta;
+    changed.writeBinaryDelta(base, delta);
+    const char extra[] = { 0x40, 0x04, 0x07, 0x00, 0x00, 0x00 };
+    string corrupt = delta + string(extra, sizeof(extra));
+    v1::Settings fromCorrupt;
+    caught = false;
+    try{ fromCorrupt.readBinaryDelta(corrupt); }catch(runtime_error&){ caught = true; }
+    printf("truncated delta path throws:\t%s\n", pf(caught && fromCorrupt.port==5));
+
+    // unknown entries are skipped when throwError doesn't throw
+    v2::Settings newBase, newChanged;
+    newChanged.retries = 9;
+    newChanged.items.resize(1);
+    newChanged.items[0].name = "after";
+    newChanged.writeBinaryDelta(newBase, delta);
+    LenientSettings lenient;
+    lenient.readBinaryDelta(delta);
+    printf("unknown delta entry skipped:\t%s\n", pf(lenient.errors.size()==1 &&
+      lenient.items.size()==1 && lenient.items[0].name=="after"));
+
+    // field ids only matter to the tagged binary format
+    SameIds same, same2;
+    same.readString("costarring=1\nliquid=2\n");
+    same.writeToBinary(bin);
+    same2.readBinary(bin);
+    caught = false;
+    try{ same.writeToTaggedBinary(bin); }catch(runtime_error&){ caught = true; }
+    printf("same field ids:\t\t\t%s\n", pf(caught && same2==same && same2.liquid==2));
+  }catch(exception& e){
+    printf("%s\n", e.what());
+    g_all_pass = false;
+  }
+
+  if(!g_all_pass) {
+      printf("not all pass\n");
+      return -1;
+  }
+  printf("all pass\n");
+  return 0;
+}
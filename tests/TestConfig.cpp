@@ -4,6 +4,12 @@
 using namespace std;
 using namespace codepi;
 
+// streambuf over a string that can't seek, like a pipe
+struct PipeBuf : public streambuf {
+  PipeBuf(const string& str) : data(str) { setg(&data[0], &data[0], &data[0]+data.size()); }
+  string data;
+};
+
 int main(){
   TestConfig tc, tc2, tc3;
 
@@ -30,6 +36,10 @@ int main(){
 
     tc.readFile("file.txt");
 
+    bool caught = false;
+    try{ tc.set("notAKey","1"); }catch(runtime_error&){ caught = true; }
+    if(!caught) throw runtime_error("Error: unknown key accepted");
+
     tc.intSet.insert(100);
     tc.intSet.insert(200);
 
@@ -51,6 +61,139 @@ int main(){
     tc3.readString(str2, size);
     if(tc!=tc3) throw runtime_error("Error: tc!=tc3");
 
+    string bin;
+    tc.writeToBinary(bin);
+    TestConfig tc4;
+    tc4.readBinary(bin);
+    if(tc!=tc4) throw runtime_error("Error: tc!=tc4 after binary round trip");
+
+    if(tc.hash()!=tc4.hash()) throw runtime_error("Error: equal structs with different hashes");
+    if(!CfgEqual()(tc,tc4) || CfgHash()(tc)!=CfgHash()(tc4)) throw runtime_error("Error: CfgEqual or CfgHash differs");
+    tc4.t[0].k++;
+    if(tc==tc4 || tc.hash()==tc4.hash()) throw runtime_error("Error: change in nested vector not detected");
+    tc4.s.i++;
+    tc4.u.k++;
+    tc4.b = !tc4.b;
+    vector<string> changed = tc.diff(tc4);
+    vector<string> expected = { "s.i", "t", "u.k", "b" };
+    if(changed!=expected) throw runtime_error("Error: diff is wrong");
+
+    ostringstream delta;
+    tc4.writeDelta(tc, delta);
+    TestConfig tc5;
+    tc5.readBinary(bin);
+    tc5.readString(delta.str());
+    if(tc5!=tc4) throw runtime_error("Error: text delta not applied");
+
+    tc4.opt1.unset();
+    string binDelta;
+    tc4.writeBinaryDelta(tc, binDelta);
+    TestConfig tc6;
+    tc6.readBinary(bin);
+    tc6.readBinaryDelta(binDelta);
+    if(tc6!=tc4) throw runtime_error("Error: binary delta not applied");
+
+    // structs in braces are read one at a time from a stream that can't seek
+    {
+      PipeBuf pipe("{ jjj=21 # } in a comment\n}\n{ jjj=22 }\n");
+      istream is(&pipe);
+      TestConfig first, second;
+      is >> first >> second;
+      if(first.jjj!=21 || second.jjj!=22 || !is) throw runtime_error("Error: structs not read one at a time from pipe");
+    }
+
+    // parsing a large vector in parallel gives the same results and errors as serially
+    {
+      ofstream big("parallel.txt");
+      big << "t=[";
+      for(int i=0; i<2000; i++){
+        big << "{ " << (i%500==0 ? "include=file2.txt\n" : "") << "i=" << i << " #comment } ]\n j=" << i*2 << " }";
+        big << (i%3 ? "," : "\n");
+      }
+      big << "]\nb=true\n";
+    }
+    TestConfig serial, parallel;
+    vector<string> serialFiles, parallelFiles;
+    serial.readFile("parallel.txt", serialFiles);
+    Configurator::setParseThreads(4);
+    parallel.readFile("parallel.txt", parallelFiles);
+    if(serial!=parallel || parallel.t.size()!=2000 || parallel.t[500].k!=7 || serialFiles!=parallelFiles)
+      throw runtime_error("Error: parallel parse differs");
+    string badVector = "t=[{i=1}";
+    for(int i=0; i<2000; i++) badVector += i==1500 ? "{i=x}" : "{i=2}";
+    badVector += "]";
+    string serialError, parallelError;
+    try{ parallel.readString(badVector); }catch(runtime_error& e){ parallelError = e.what(); }
+    Configurator::setParseThreads(1);
+    try{ serial.readString(badVector); }catch(runtime_error& e){ serialError = e.what(); }
+    if(serialError.empty() || serialError!=parallelError || serial!=parallel)
+      throw runtime_error("Error: parallel parse error differs");
+    remove("parallel.txt");
+
+    // prefetched includes are applied in the same order as when read one at a time
+    {
+      ofstream("include_a.txt") << "jjj=1\ninclude=include_b.txt\nn=from a\n";
+      ofstream("include_b.txt") << "jjj=2\nn=from b\n# include=include_missing.txt\n";
+      ofstream("include_c.txt") << "u.include = include_d.txt\n";
+      ofstream("include_d.txt") << "i=5\n";
+    }
+    string includes = "include=include_a.txt\njjj=3\ninclude=include_c.txt\nu.j=4\n";
+    TestConfig sequential, prefetched;
+    sequential.readString(includes);
+    Configurator::setPrefetchIncludes(true);
+    prefetched.readString(includes);
+    if(sequential!=prefetched || prefetched.jjj!=3 || prefetched.n!="from a" || prefetched.u.i!=5 ||
+       prefetched.u.j!=4)
+      throw runtime_error("Error: prefetched includes differ");
+    string prefetchedError, sequentialError;
+    try{ prefetched.readString("include=include_a.txt\ninclude=include_missing.txt\n"); }
+    catch(runtime_error& e){ prefetchedError = e.what(); }
+    Configurator::setPrefetchIncludes(false);
+    try{ sequential.readString("include=include_a.txt\ninclude=include_missing.txt\n"); }
+    catch(runtime_error& e){ sequentialError = e.what(); }
+    if(sequentialError.empty() || sequentialError!=prefetchedError)
+      throw runtime_error("Error: prefetched include error differs");
+
+    // cached includes are parsed once, and only their changed entries are parsed again
+    TestConfig uncached;
+    uncached.readString(includes);
+    Configurator::setIncludeCache(true);
+    TestConfig cached1, cached2;
+    cached1.readString(includes);
+    cached2.readString(includes);
+    unsigned long long hits, misses;
+    Configurator::getIncludeCacheStats(hits, misses);
+    if(cached1!=uncached || cached2!=uncached || hits!=5 || misses!=9)
+      throw runtime_error("Error: cached includes differ");
+    ofstream("include_a.txt") << "jjj=1\ninclude=include_b.txt\nn=from A\n"; // same size and second
+    cached2.readString(includes);
+    Configurator::getIncludeCacheStats(hits, misses);
+    if(cached2.n!="from A" || hits!=9 || misses!=12)
+      throw runtime_error("Error: changed include not read again");
+
+    // nested structs are cached entry by entry, vectors of structs as a whole
+    Configurator::clearIncludeCache();
+    ofstream("include_e.txt") << "s={ i=1\n k=2 }\nt=[{i=3}, {j=4}]\nk=[1, 2]\n";
+    TestConfig nested1, nested2;
+    nested1.readFile("include_e.txt");
+    ofstream("include_e.txt") << "s={ i=1\n k=5 }\nt=[{i=3}, {j=4}]\nk=[1, 2]\n";
+    nested2.readFile("include_e.txt");
+    Configurator::getIncludeCacheStats(hits, misses);
+    if(nested2.s.i!=1 || nested2.s.k!=5 || nested2.t.size()!=2 || nested2.t[1].j!=4 || nested2.k.size()!=2 ||
+       hits!=3 || misses!=5)
+      throw runtime_error("Error: unchanged entries of an include parsed again");
+    Configurator::setIncludeCache(false);
+    Configurator::clearIncludeCache();
+    remove("include_a.txt");
+    remove("include_b.txt");
+    remove("include_c.txt");
+    remove("include_d.txt");
+    remove("include_e.txt");
+
+    tc2.pair2.second = 1.0f/3;
+    tc3.readString(tc2.toString());
+    if(tc2!=tc3) throw runtime_error("Error: float not written losslessly");
+
   }catch(exception& e){
     cout<<e.what()<<endl;
   }
@@ -0,0 +1,163 @@
+// Tests for unordered_set, unordered_map, deque, list and SmallVector
+// entries: text and binary round trips, order independent equality and
+// hash, and SmallVector itself
+
+#include "../Configurator/configurator.h"
+#include <stdio.h>
+
+using namespace std;
+using namespace codepi;
+
+bool g_all_pass = true;
+
+const char* pf(bool test){
+  if(test==true) return "pass";
+  else {
+      g_all_pass = false;
+      return "fail";
+  }
+}
+
+struct Route : public Configurator {
+  string host;
+  int port;
+
+  CFG_HEADER(Route)
+  CFG_ENTRY(host)
+  CFG_ENTRY(port)
+  CFG_TAIL
+};
+
+struct ContainersConfig : public Configurator {
+  unordered_map<string,int> flags;
+  unordered_map<string,Route> routes;
+  unordered_set<int> ids;
+  deque<string> queue;
+  list<double> weights;
+  SmallVector<int,4> small;
+  SmallVector<Route,2> smallRoutes;
+
+  CFG_HEADER(ContainersConfig)
+  CFG_ENTRY(flags)
+  CFG_ENTRY(routes)
+  CFG_ENTRY(ids)
+  CFG_ENTRY(queue)
+  CFG_ENTRY(weights)
+  CFG_ENTRY(small)
+  CFG_ENTRY(smallRoutes)
+  CFG_TAIL
+};
+
+// same binary format, with the ordered containers
+struct OrderedConfig : public Configurator {
+  map<string,int> flags;
+  map<string,Route> routes;
+  std::set<int> ids; // set alone would name Configurator::set
+  vector<string> queue;
+  vector<double> weights;
+  vector<int> small;
+  vector<Route> smallRoutes;
+
+  CFG_HEADER(OrderedConfig)
+  CFG_ENTRY(flags)
+  CFG_ENTRY(routes)
+  CFG_ENTRY(ids)
+  CFG_ENTRY(queue)
+  CFG_ENTRY(weights)
+  CFG_ENTRY(small)
+  CFG_ENTRY(smallRoutes)
+  CFG_TAIL
+};
+
+int main(){
+  try{
+    const char* text =
+      "flags=[alpha, 1, beta, 0, gamma, 1]\n"
+      "routes=[main, {host=a.example\nport=80}, backup, {host=b.example\nport=8080}]\n"
+      "ids=[3, 1, 4, 15, 9]\n"
+      "queue=[first, second, third]\n"
+      "weights=[0.5, 0.25, 2]\n"
+      "small=[1, 2, 3, 4, 5, 6]\n"
+      "smallRoutes=[{host=c\nport=1}]\n";
+    ContainersConfig cfg;
+    cfg.readString(text);
+    printf("parse:\t\t\t\t%s\n", pf(cfg.flags.size()==3 && cfg.flags["beta"]==0 &&
+      cfg.routes["backup"].port==8080 && cfg.ids.count(15) && cfg.ids.size()==5 &&
+      cfg.queue.back()=="third" && cfg.weights.front()==0.5 &&
+      cfg.small.size()==6 && cfg.small[5]==6 && cfg.smallRoutes[0].host=="c"));
+
+    ContainersConfig copy;
+    copy.readString(cfg.toString());
+    printf("text round trip:\t\t%s\n", pf(copy==cfg));
+
+    // same contents inserted in another order, so likely iterated differently
+    ContainersConfig reordered;
+    reordered.readString(
+      "flags=[gamma, 1, beta, 0, alpha, 1]\n"
+      "routes=[backup, {host=b.example\nport=8080}, main, {host=a.example\nport=80}]\n"
+      "ids=[9, 15, 4, 1, 3]\n"
+      "queue=[first, second, third]\n"
+      "weights=[0.5, 0.25, 2]\n"
+      "small=[1, 2, 3, 4, 5, 6]\n"
+      "smallRoutes=[{host=c\nport=1}]\n");
+    reordered.flags.rehash(64);
+    printf("unordered equality:\t\t%s\n", pf(reordered==cfg && reordered.hash()==cfg.hash()));
+
+    reordered.routes["main"].port = 81;
+    printf("unordered value differs:\t%s\n", pf(reordered!=cfg));
+    reordered = cfg;
+    reordered.ids.erase(4);
+    reordered.ids.insert(5);
+    printf("unordered key differs:\t\t%s\n", pf(reordered!=cfg && reordered.hash()!=cfg.hash()));
+    reordered = cfg;
+    reordered.queue.push_front("zeroth");
+    printf("deque differs:\t\t\t%s\n", pf(reordered!=cfg));
+
+    string bin;
+    cfg.writeToBinary(bin);
+    ContainersConfig binCopy;
+    binCopy.readBinary(bin);
+    printf("binary round trip:\t\t%s\n", pf(binCopy==cfg));
+
+    string tagged;
+    cfg.writeToTaggedBinary(tagged);
+    ContainersConfig taggedCopy;
+    printf("tagged round trip:\t\t%s\n", pf(taggedCopy.readTaggedBinary(tagged) && taggedCopy==cfg));
+
+    // the binary format is the same for each kind of container
+    OrderedConfig ordered;
+    ordered.readBinary(bin);
+    printf("read as ordered containers:\t%s\n", pf(ordered.flags["gamma"]==1 &&
+      ordered.routes["main"].host=="a.example" && *ordered.ids.begin()==1 &&
+      ordered.queue[1]=="second" && ordered.weights[2]==2 &&
+      ordered.small.size()==6 && ordered.smallRoutes[0].port==1));
+  }catch(exception& e){
+    printf("%s\n", e.what());
+    g_all_pass = false;
+  }
+
+  // SmallVector storage: inline up to N, then on the heap
+  SmallVector<string,2> sv;
+  sv.push_back("a");
+  const string* inlineData = sv.data();
+  sv.push_back("b");
+  bool isInline = sv.data()==inlineData && sv.capacity()==2;
+  sv.push_back(sv[0]); // element of itself, while growing
+  printf("small vector grows:\t\t%s\n", pf(isInline && sv.data()!=inlineData &&
+    sv.size()==3 && sv[2]=="a" && sv[1]=="b"));
+  sv.insert(sv.begin()+1, "x");
+  printf("small vector insert:\t\t%s\n", pf(sv==SmallVector<string,2>({"a","x","b","a"})));
+  const string* heapData = sv.data();
+  SmallVector<string,2> moved(std::move(sv));
+  printf("small vector move:\t\t%s\n", pf(moved.data()==heapData && moved.size()==4 && sv.empty()));
+  SmallVector<string,2> copied(moved);
+  copied.resize(1);
+  printf("small vector copy:\t\t%s\n", pf(copied.size()==1 && copied[0]=="a" && moved.size()==4));
+
+  if(!g_all_pass) {
+      printf("not all pass\n");
+      return -1;
+  }
+  printf("all pass\n");
+  return 0;
+}
@@ -0,0 +1,132 @@
+// Tests for structs declared with CFG_FIELDS: same behavior as the same
+// struct declared with CFG_HEADER ... CFG_TAIL, also mixed in a hierarchy
+
+#include "TestConfig.h"
+#include <stdio.h>
+
+using namespace std;
+using namespace codepi;
+
+bool g_all_pass = true;
+
+const char* pf(bool test){
+  if(test==true) return "pass";
+  else {
+      g_all_pass = false;
+      return "fail";
+  }
+}
+
+struct HeaderItem : public Configurator {
+  int id;
+  string name;
+  vector<int> values;
+  Optional<double> weight;
+
+  CFG_HEADER(HeaderItem)
+  CFG_ENTRY_DEF(id, 5)
+  CFG_ENTRY_DEF(name, "none")
+  CFG_ENTRY(values)
+  CFG_ENTRY(weight)
+  CFG_TAIL
+};
+
+struct FieldsItem : public Configurator {
+  int id;
+  string name;
+  vector<int> values;
+  Optional<double> weight;
+
+  CFG_FIELDS(FieldsItem,
+    CFG_FIELD_DEF(id, 5),
+    CFG_FIELD_DEF(name, "none"),
+    CFG_FIELD(values),
+    CFG_FIELD(weight))
+};
+
+struct FieldsPoint : public Configurator {
+  int x;
+  string label;
+
+  CFG_FIELDS(FieldsPoint, CFG_FIELD_DEF(x, 5), CFG_FIELD(label))
+};
+
+// CFG_FIELDS with a CFG_HEADER parent
+struct FieldsChild : public SubConfig1 {
+  int extra;
+  vector<FieldsPoint> items;
+
+  CFG_FIELDS_PARENT(FieldsChild, SubConfig1,
+    CFG_FIELD_DEF(extra, 3),
+    CFG_FIELD(items))
+};
+
+// CFG_HEADER with a CFG_FIELDS parent
+struct HeaderChild : public FieldsItem {
+  bool flag;
+
+  CFG_HEADER(HeaderChild)
+  CFG_ENTRY_DEF(flag, true)
+  CFG_PARENT(FieldsItem)
+  CFG_TAIL
+};
+
+int main(){
+  try{
+    HeaderItem header;
+    FieldsItem fields;
+    printf("defaults:\t\t\t%s\n", pf(fields.id==5 && fields.name=="none" && !fields.weight.isSet()));
+
+    const char* text = "id=7\nname=seven\nvalues=[1,2,3]\nweight=2.5\n";
+    header.readString(text);
+    fields.readString(text);
+    printf("same text as CFG_HEADER:\t%s\n", pf(fields.toString()==header.toString() &&
+      fields.values.size()==3 && fields.weight.get()==2.5));
+
+    FieldsItem copy;
+    copy.readString(fields.toString());
+    FieldsItem other;
+    other.readString("id=8");
+    printf("equality and hash:\t\t%s\n", pf(copy==fields && copy.hash()==fields.hash() && !(other==fields)));
+    vector<string> changed = other.diff(fields);
+    vector<string> expected = { "id", "name", "values", "weight" };
+    printf("diff:\t\t\t\t%s\n", pf(changed==expected));
+
+    string bin;
+    fields.writeToBinary(bin);
+    FieldsItem fromBin;
+    fromBin.readBinary(bin);
+    fields.writeToTaggedBinary(bin);
+    FieldsItem fromTagged;
+    fromTagged.id = 100;
+    bool sameSchema = fromTagged.readTaggedBinary(bin);
+    printf("binary round trips:\t\t%s\n", pf(fromBin==fields && sameSchema && fromTagged==fields));
+
+    FieldsChild child;
+    printf("parent defaults:\t\t%s\n", pf(child.extra==3 && child.i==7 && child.k==9));
+    child.readString("extra=4\nitems=[{x=1}{label=two}]\nk=10\n");
+    child.set("j", "6");
+    printf("parent entries:\t\t\t%s\n", pf(child.extra==4 && child.items.size()==2 &&
+      child.items[0].x==1 && child.items[1].label=="two" && child.items[1].x==5 && child.k==10 && child.j==6));
+    FieldsChild childCopy;
+    childCopy.readString(child.toString());
+    printf("parent round trip:\t\t%s\n", pf(childCopy==child));
+
+    HeaderChild mixed;
+    printf("CFG_PARENT of CFG_FIELDS:\t%s\n", pf(mixed.flag && mixed.id==5 && mixed.name=="none"));
+    mixed.readString("flag=false\nid=9\n");
+    HeaderChild mixedCopy;
+    mixedCopy.readString(mixed.toString());
+    printf("mixed round trip:\t\t%s\n", pf(mixedCopy==mixed && mixedCopy.id==9 && !mixedCopy.flag));
+  }catch(exception& e){
+    printf("%s\n", e.what());
+    g_all_pass = false;
+  }
+
+  if(!g_all_pass) {
+      printf("not all pass\n");
+      return -1;
+  }
+  printf("all pass\n");
+  return 0;
+}
@@ -0,0 +1,133 @@
+// Tests for Lazy<T> entries: parsed on first access, with the same results
+// as entries of type T
+
+#include "../Configurator/configurator.h"
+#include <stdio.h>
+
+using namespace std;
+using namespace codepi;
+
+bool g_all_pass = true;
+
+const char* pf(bool test){
+  if(test==true) return "pass";
+  else {
+      g_all_pass = false;
+      return "fail";
+  }
+}
+
+struct LazySection : public Configurator {
+  int x;
+  string name;
+  vector<int> values;
+
+  CFG_HEADER(LazySection)
+  CFG_ENTRY_DEF(x, 7)
+  CFG_ENTRY(name)
+  CFG_ENTRY(values)
+  CFG_TAIL
+};
+
+struct LazyConfig : public Configurator {
+  int port;
+  Lazy<LazySection> section;
+  Lazy< vector<LazySection> > sections;
+  Lazy<int> count;
+
+  CFG_HEADER(LazyConfig)
+  CFG_ENTRY(port)
+  CFG_ENTRY(section)
+  CFG_ENTRY(sections)
+  CFG_ENTRY(count)
+  CFG_TAIL
+};
+
+// same entries, parsed right away
+struct EagerConfig : public Configurator {
+  int port;
+  LazySection section;
+  vector<LazySection> sections;
+  int count;
+
+  CFG_HEADER(EagerConfig)
+  CFG_ENTRY(port)
+  CFG_ENTRY(section)
+  CFG_ENTRY(sections)
+  CFG_ENTRY(count)
+  CFG_TAIL
+};
+
+int main(){
+  const char* text =
+    "port=80\n"
+    "section={\n"
+    "  name=first # comment with } in it\n"
+    "  values=[1, 2, 3]\n"
+    "}\n"
+    "sections=[{x=1}, {x=2\n name=a\\]b}]\n"
+    "count=4\n";
+
+  try{
+    LazyConfig cfg;
+    cfg.readString(text);
+    printf("pending after read:\t\t%s\n", pf(cfg.section.isPending() && cfg.sections.isPending() &&
+      !cfg.count.isPending() && cfg.count==4 && cfg.port==80));
+    printf("parsed on access:\t\t%s\n", pf(cfg.section->name=="first" && cfg.section->x==7 &&
+      cfg.section->values.size()==3 && !cfg.section.isPending() && cfg.sections.isPending()));
+
+    EagerConfig eager;
+    eager.readString(text);
+    printf("same text as eager:\t\t%s\n", pf(cfg.toString()==eager.toString() &&
+      cfg.sections.get()[1].name=="a]b"));
+
+    // entries are applied in order, as they would be to a LazySection
+    LazyConfig merged;
+    merged.readString("section={name=a}\nsection={x=2}\nsection.values=[5]\n");
+    printf("entries merged in order:\t%s\n", pf(merged.section->name=="a" && merged.section->x==2 &&
+      merged.section->values==vector<int>({5})));
+
+    LazyConfig copy1, copy2;
+    copy1.readString(text);
+    copy2 = copy1;
+    printf("copy of pending:\t\t%s\n", pf(copy2.section.isPending() && copy2==cfg &&
+      copy1.hash()==cfg.hash()));
+
+    string bin;
+    cfg.writeToBinary(bin);
+    EagerConfig fromBin;
+    fromBin.readBinary(bin);
+    printf("binary same as eager:\t\t%s\n", pf(fromBin==eager));
+
+    cfg.section = LazySection();
+    printf("assignment:\t\t\t%s\n", pf(cfg.section->name.empty() && cfg.section->x==7));
+  }catch(exception& e){
+    printf("%s\n", e.what());
+    g_all_pass = false;
+  }
+
+  LazyConfig bad;
+  bool threwOnRead = false, threwOnAccess = false;
+  try{ bad.readString("section={x=notanumber}\nport=1\n"); }
+  catch(exception&){ threwOnRead = true; }
+  try{ bad.section->x++; }
+  catch(exception&){ threwOnAccess = true; }
+  printf("error on first access:\t\t%s\n", pf(!threwOnRead && threwOnAccess && bad.port==1));
+
+  // the error stays, instead of a half parsed value
+  bool threwAgain = false;
+  try{ bad.section->x++; }
+  catch(exception&){ threwAgain = true; }
+  LazyConfig badCopy = bad;
+  bool copyThrew = false;
+  try{ badCopy.section.get(); }
+  catch(exception&){ copyThrew = true; }
+  printf("error on every access:\t\t%s\n", pf(threwAgain && copyThrew && bad.section.isPending()));
+
+  if(!g_all_pass) {
+      printf("not all pass\n");
+      return -1;
+  }
+  printf("all pass\n");
+  return 0;
+}
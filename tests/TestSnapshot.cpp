@@ -0,0 +1,84 @@
+// Tests for ConfigSnapshot: updates on a copy, failed updates publishing
+// nothing, and readers never seeing a half updated config
+
+#include "../Configurator/ConfigSnapshot.h"
+#include "TestConfig.h"
+#include <stdio.h>
+
+using namespace std;
+using namespace codepi;
+
+bool g_all_pass = true;
+
+const char* pf(bool test){
+  if(test==true) return "pass";
+  else {
+      g_all_pass = false;
+      return "fail";
+  }
+}
+
+// writers keep first==second
+struct PairConfig : public Configurator {
+  int first;
+  int second;
+
+  CFG_HEADER(PairConfig)
+  CFG_ENTRY_DEF(first, 0)
+  CFG_ENTRY_DEF(second, 0)
+  CFG_TAIL
+};
+
+int main(){
+  try{
+    ConfigSnapshot<TestConfig> config;
+    shared_ptr<const TestConfig> before = config.get();
+    config.update([](TestConfig& tc){ tc.readFile("file.txt"); });
+    config.set("opt1", "7");
+    {
+      ConfigSnapshot<TestConfig>::Reader cfg = config.read();
+      printf("update and set:\t\t\t%s\n", pf(cfg->opt1.isSet() && cfg->opt1.get()==7 && cfg->jjj==22 &&
+        config.version()==2));
+      printf("old snapshot unchanged:\t\t%s\n", pf(!before->opt1.isSet() && before->jjj==12));
+    }
+
+    shared_ptr<const TestConfig> current = config.get();
+    bool caught = false;
+    try{ config.readString("jjj=notanumber\n"); }catch(runtime_error&){ caught = true; }
+    printf("failed update throws:\t\t%s\n", pf(caught));
+    printf("failed update not published:\t%s\n", pf(config.get()==current && config.version()==2));
+
+    // readers check the invariant while a writer keeps updating
+    ConfigSnapshot<PairConfig> pair;
+    atomic<bool> stop(false);
+    atomic<long> bad(0), reads(0), started(0);
+    vector<thread> readers;
+    for(int i=0; i<4; i++){
+      readers.push_back(thread([&]{
+        started++;
+        while(!stop){
+          ConfigSnapshot<PairConfig>::Reader cfg = pair.read();
+          if(cfg->first!=cfg->second) bad++;
+          reads++;
+        }
+      }));
+    }
+    while(started<4) this_thread::yield();
+    for(int i=1; i<=1000; i++){
+      pair.update([i](PairConfig& cfg){ cfg.first = i; cfg.second = i; });
+    }
+    stop = true;
+    for(size_t i=0; i<readers.size(); i++) readers[i].join();
+    printf("concurrent readers consistent:\t%s\n", pf(bad==0 && reads>0 && pair.read()->first==1000));
+  }catch(exception& e){
+    printf("%s\n", e.what());
+    g_all_pass = false;
+  }
+
+  if(!g_all_pass) {
+      printf("not all pass\n");
+      return -1;
+  }
+  printf("all pass\n");
+  return 0;
+}
@@ -0,0 +1,142 @@
+// Tests for the streaming parse: the events of readStringEvents and
+// readFileEvents, and elements passed one at a time by readFileElements
+
+#include "../Configurator/configurator.h"
+#include <stdio.h>
+#include <fstream>
+
+using namespace std;
+using namespace codepi;
+
+bool g_all_pass = true;
+
+const char* pf(bool test){
+  if(test==true) return "pass";
+  else {
+      g_all_pass = false;
+      return "fail";
+  }
+}
+
+struct StreamItem : public Configurator {
+  int id;
+  string name;
+
+  CFG_HEADER(StreamItem)
+  CFG_ENTRY(id)
+  CFG_ENTRY(name)
+  CFG_TAIL
+};
+
+struct StreamSub : public Configurator {
+  vector<StreamItem> items;
+  int count;
+
+  CFG_HEADER(StreamSub)
+  CFG_ENTRY(items)
+  CFG_ENTRY(count)
+  CFG_TAIL
+};
+
+struct StreamConfig : public Configurator {
+  string title;
+  vector<StreamItem> items;
+  vector<int> ids;
+  StreamSub sub;
+
+  CFG_HEADER(StreamConfig)
+  CFG_ENTRY(title)
+  CFG_ENTRY(items)
+  CFG_ENTRY(ids)
+  CFG_ENTRY(sub)
+  CFG_TAIL
+};
+
+// records each event as a line
+struct RecordEvents : public CfgEventHandler {
+  void key(const string& name){ events += "key " + name + "\n"; }
+  void beginStruct(){ events += "{\n"; }
+  void endStruct(){ events += "}\n"; }
+  void beginList(){ events += "[\n"; }
+  void endList(){ events += "]\n"; }
+  void value(const string& text){ events += "value " + text + "\n"; }
+  string events;
+};
+
+int main(){
+  const char* text =
+    "# comment\n"
+    "title = a \\# b\n"
+    "items=[{id=1\n name=one}, {id=2\n name=''}] # trailing comment\n"
+    "ids=[3, 4]\n"
+    "sub={\n"
+    "  count=2\n"
+    "  items=[{id=5\n name=five\\, or so}]\n"
+    "}\n";
+
+  try{
+    RecordEvents record;
+    Configurator::readStringEvents(text, record);
+    printf("events:\t\t\t\t%s\n", pf(record.events==
+      "key title\nvalue a # b\n"
+      "key items\n[\n{\nkey id\nvalue 1\nkey name\nvalue one\n}\n{\nkey id\nvalue 2\nkey name\nvalue \n}\n]\n"
+      "key ids\n[\nvalue 3\nvalue 4\n]\n"
+      "key sub\n{\nkey count\nvalue 2\nkey items\n[\n{\nkey id\nvalue 5\nkey name\nvalue five, or so\n}\n]\n}\n"));
+
+    ofstream("stream.txt") << text;
+    RecordEvents fromFile;
+    Configurator::readFileEvents("stream.txt", fromFile);
+    printf("file events:\t\t\t%s\n", pf(fromFile.events==record.events));
+
+    StreamConfig cfg;
+    vector<int> seen;
+    cfg.readFileElements<StreamItem>("stream.txt", "items", [&](StreamItem& item){
+      seen.push_back(item.id);
+    });
+    printf("top level elements:\t\t%s\n", pf(seen==vector<int>({1,2}) && cfg.items.empty() &&
+      cfg.title=="a # b" && cfg.ids.size()==2 && cfg.sub.items.size()==1 && cfg.sub.count==2));
+
+    StreamConfig nested;
+    vector<string> names;
+    nested.readFileElements<StreamItem>("stream.txt", "sub.items", [&](StreamItem& item){
+      names.push_back(item.name);
+    });
+    printf("nested elements:\t\t%s\n", pf(names==vector<string>({"five, or so"}) &&
+      nested.sub.items.empty() && nested.sub.count==2 && nested.items.size()==2));
+
+    StreamConfig numbers;
+    int sum = 0;
+    numbers.readFileElements<int>("stream.txt", "ids", [&](int& id){ sum += id; });
+    printf("number elements:\t\t%s\n", pf(sum==7 && numbers.ids.empty()));
+
+    // list values are split on whitespace too, as for containers
+    RecordEvents spaced;
+    Configurator::readStringEvents("v=[1 2\t3, a\\ b '']\n", spaced);
+    printf("space separated list:\t\t%s\n", pf(spaced.events==
+      "key v\n[\nvalue 1\nvalue 2\nvalue 3\nvalue a b\nvalue \n]\n"));
+  }catch(exception& e){
+    printf("%s\n", e.what());
+    g_all_pass = false;
+  }
+
+  RecordEvents unbalanced;
+  bool threw = false;
+  try{ Configurator::readStringEvents("a=[1, 2\nb=3\n", unbalanced); }
+  catch(exception&){ threw = true; }
+  printf("missing bracket throws:\t\t%s\n", pf(threw));
+
+  ofstream("stream.txt") << "items=[{id=1\n name=one} {id=x}]\n";
+  StreamConfig bad;
+  threw = false;
+  try{ bad.readFileElements<StreamItem>("stream.txt", "items", [](StreamItem&){}); }
+  catch(exception&){ threw = true; }
+  printf("bad element throws:\t\t%s\n", pf(threw));
+  remove("stream.txt");
+
+  if(!g_all_pass) {
+      printf("not all pass\n");
+      return -1;
+  }
+  printf("all pass\n");
+  return 0;
+}
@@ -0,0 +1,165 @@
+// Tests for visit(): the entries reached, their order, and modifying them
+// through a visitor, for CFG_HEADER and CFG_FIELDS structs
+
+#include "../Configurator/configurator.h"
+#include <stdio.h>
+#include <sstream>
+
+using namespace std;
+using namespace codepi;
+
+bool g_all_pass = true;
+
+const char* pf(bool test){
+  if(test==true) return "pass";
+  else {
+      g_all_pass = false;
+      return "fail";
+  }
+}
+
+struct VisitPoint : public Configurator {
+  int x;
+  string label;
+
+  CFG_FIELDS(VisitPoint, CFG_FIELD_DEF(x, 1), CFG_FIELD_DEF(label, "p"))
+};
+
+struct VisitBase : public Configurator {
+  double scale;
+
+  CFG_HEADER(VisitBase)
+  CFG_ENTRY_DEF(scale, 0.5)
+  CFG_TAIL
+};
+
+struct VisitConfig : public VisitBase {
+  int count;
+  VisitPoint origin;
+  vector<VisitPoint> points;
+  map<string,int> limits;
+  std::set<int> ids; // set alone would name Configurator::set
+  Optional<int> maybe;
+  pair<int,string> tagged;
+  array<int,2> pairOfInts;
+
+  CFG_HEADER(VisitConfig)
+  CFG_ENTRY_DEF(count, 3)
+  CFG_ENTRY(origin)
+  CFG_ENTRY(points)
+  CFG_ENTRY(limits)
+  CFG_ENTRY(ids)
+  CFG_ENTRY(maybe)
+  CFG_ENTRY(tagged)
+  CFG_ENTRY(pairOfInts)
+  CFG_PARENT(VisitBase)
+  CFG_TAIL
+};
+
+// records each call as a line, with the path of the value
+struct PathVisitor : public CfgVisitor {
+  template <typename T> void value(const char* name, T& val){
+    ostringstream oss;
+    oss << path() << name << "=" << val;
+    lines.push_back(oss.str());
+  }
+  template <typename T> void beginStruct(const char* name, T& cfg){
+    stack.push_back(string(name)+"{"+cfg.getStructName()+"}.");
+  }
+  template <typename T> void endStruct(const char* name, T& cfg){ stack.pop_back(); }
+  void beginContainer(const char* name, size_t size){
+    ostringstream oss;
+    oss << name << "[" << size << "]";
+    stack.push_back(oss.str());
+  }
+  void endContainer(const char* name){ stack.pop_back(); }
+
+  string path(){
+    string p;
+    for(size_t i=0; i<stack.size(); i++) p += stack[i];
+    return p;
+  }
+
+  vector<string> stack;
+  vector<string> lines;
+};
+
+// doubles every int it is allowed to modify, ignores everything else
+struct DoubleInts : public CfgVisitor {
+  using CfgVisitor::value;
+  void value(const char* name, int& val){ val *= 2; }
+};
+
+// counts the entries of each kind
+struct CountVisitor : public CfgVisitor {
+  CountVisitor() : values(0), structs(0), containers(0) {}
+  template <typename T> void value(const char* name, T& val){ values++; }
+  template <typename T> void beginStruct(const char* name, T& cfg){ structs++; }
+  void beginContainer(const char* name, size_t size){ containers++; }
+  int values, structs, containers;
+};
+
+int main(){
+  try{
+    VisitConfig cfg;
+    cfg.readString("points=[{x=2 label=a},{x=3 label=b}]\n"
+      "limits=[lo,1,hi,9]\nids=[4,5]\n"
+      "pairOfInts=[10,20]\nscale=2\n");
+    cfg.tagged = make_pair(7, "seven");
+
+    PathVisitor paths;
+    cfg.visit(paths);
+    const char* expected[] = {
+      "count=3",
+      "origin{VisitPoint}.x=1",
+      "origin{VisitPoint}.label=p",
+      "points[2]{VisitPoint}.x=2",
+      "points[2]{VisitPoint}.label=a",
+      "points[2]{VisitPoint}.x=3",
+      "points[2]{VisitPoint}.label=b",
+      "limits[2][2]=hi",
+      "limits[2][2]=9",
+      "limits[2][2]=lo",
+      "limits[2][2]=1",
+      "ids[2]=4",
+      "ids[2]=5",
+      "tagged[2]=7",
+      "tagged[2]=seven",
+      "pairOfInts[2]=10",
+      "pairOfInts[2]=20",
+      "scale=2",
+    };
+    vector<string> expectedLines(expected, expected+sizeof(expected)/sizeof(expected[0]));
+    printf("entries in order:\t\t%s\n", pf(paths.lines==expectedLines && paths.stack.empty()));
+
+    cfg.maybe = 6;
+    paths.lines.clear();
+    cfg.visit(paths);
+    printf("optional set:\t\t\t%s\n", pf(paths.lines.size()==expectedLines.size()+1 &&
+      paths.lines[13]=="maybe[1]=6"));
+
+    DoubleInts doubler;
+    cfg.visit(doubler);
+    printf("modify through visitor:\t\t%s\n", pf(cfg.count==6 && cfg.origin.x==2 &&
+      cfg.points[1].x==6 && cfg.limits["hi"]==18 && *cfg.ids.begin()==4 &&
+      cfg.maybe==12 && cfg.tagged.first==14 && cfg.pairOfInts[1]==40));
+
+    CountVisitor counts;
+    cfg.origin.visit(counts);
+    printf("CFG_FIELDS struct:\t\t%s\n", pf(counts.values==2 && counts.structs==0 && counts.containers==0));
+
+    counts = CountVisitor();
+    cfg.visit(counts);
+    printf("counts:\t\t\t\t%s\n", pf(counts.values==19 && counts.structs==3 && counts.containers==8));
+  }catch(exception& e){
+    printf("%s\n", e.what());
+    g_all_pass = false;
+  }
+
+  if(!g_all_pass) {
+      printf("not all pass\n");
+      return -1;
+  }
+  printf("all pass\n");
+  return 0;
+}
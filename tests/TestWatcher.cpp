@@ -0,0 +1,85 @@
+// Tests for ConfigWatcher: reloading when the file or an included file
+// changes, and keeping the previous snapshot when reading fails
+
+#include "../Configurator/ConfigWatcher.h"
+#include <stdio.h>
+
+using namespace std;
+using namespace codepi;
+
+bool g_all_pass = true;
+
+const char* pf(bool test){
+  if(test==true) return "pass";
+  else {
+      g_all_pass = false;
+      return "fail";
+  }
+}
+
+struct WatchedConfig : public Configurator {
+  int port;
+  string host;
+
+  CFG_HEADER(WatchedConfig)
+  CFG_ENTRY_DEF(port, 80)
+  CFG_ENTRY(host)
+  CFG_TAIL
+};
+
+static void writeFile(const char* filename, const char* contents){
+  ofstream ofs(filename);
+  ofs << contents;
+}
+
+// waits until func returns true, up to 5 seconds
+static bool waitFor(const function<bool()>& func){
+  for(int i=0; i<500; i++){
+    if(func()) return true;
+    this_thread::sleep_for(chrono::milliseconds(10));
+  }
+  return false;
+}
+
+int main(){
+  writeFile("watched.txt", "port=8080\n");
+  writeFile("watched_include.txt", "host=example.com\n");
+
+  mutex errorMutex;
+  string error;
+  {
+    ConfigWatcher<WatchedConfig> watcher("watched.txt", [&](const string& e){
+      lock_guard<mutex> lock(errorMutex);
+      error = e;
+    });
+    printf("initial read:\t\t\t%s\n", pf(watcher.get()->port==8080 && watcher.version()==1));
+
+    writeFile("watched.txt", "port=8081\ninclude=watched_include.txt\n");
+    bool reloaded = waitFor([&]{ return watcher.get()->port==8081; });
+    printf("file changed:\t\t\t%s\n", pf(reloaded && watcher.get()->host=="example.com"));
+    printf("include watched:\t\t%s\n", pf(watcher.files().size()==2));
+
+    writeFile("watched_include.txt", "host=example.org\n");
+    reloaded = waitFor([&]{ return watcher.get()->host=="example.org"; });
+    printf("included file changed:\t\t%s\n", pf(reloaded));
+
+    shared_ptr<const WatchedConfig> before = watcher.get();
+    writeFile("watched.txt", "port=notanumber\n");
+    bool reported = waitFor([&]{ lock_guard<mutex> lock(errorMutex); return !error.empty(); });
+    printf("error reported:\t\t\t%s\n", pf(reported));
+    printf("old snapshot kept:\t\t%s\n", pf(watcher.get()==before && before->port==8081));
+
+    writeFile("watched.txt", "port=9000\n");
+    reloaded = waitFor([&]{ return watcher.get()->port==9000; });
+    printf("recovered after error:\t\t%s\n", pf(reloaded));
+  }
+  remove("watched.txt");
+  remove("watched_include.txt");
+
+  if(!g_all_pass) {
+      printf("not all pass\n");
+      return -1;
+  }
+  printf("all pass\n");
+  return 0;
+}
@@ -14,3 +14,27 @@ echo TestConfig3
 echo --------------------------
 echo testOptional
 ./testOptional
+echo --------------------------
+echo TestBinary
+./TestBinary
+echo --------------------------
+echo TestWatcher
+./TestWatcher
+echo --------------------------
+echo TestSnapshot
+./TestSnapshot
+echo --------------------------
+echo TestFields
+./TestFields
+echo --------------------------
+echo TestVisit
+./TestVisit
+echo --------------------------
+echo TestContainers
+./TestContainers
+echo --------------------------
+echo TestStream
+./TestStream
+echo --------------------------
+echo TestLazy
+./TestLazy
@@ -93,6 +93,23 @@ int main(){
   const int& v11i = v11;
   printf("const ref test: %s\n", pf(v11==v11i));
 
+  // test12
+  Optional<vector<int>> v12(vector<int>({1,2,3}));
+  orig = v12->data();
+  Optional<vector<int>> ov12(move(v12));
+  curr = ov12->data();
+  printf("construct by move wrapper:\t%p\t%p\t%s\n", orig, curr, pf(orig==curr && !v12.isSet()));
+
+  // test13
+  const Optional<int> v13;
+  Optional<int> ov13(v13);
+  printf("copy of empty const: %s\n", pf(!ov13.isSet()));
+
+  // test14
+  Optional<int> ov14 = 1;
+  ov14 = v13;
+  printf("assignment of empty: %s\n", pf(!ov14.isSet()));
+
   if(!g_all_pass) {
       printf("not all pass\n");
       return -1;